@@ -0,0 +1,192 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "ac.h"
+
+#define AC_OUT 0x80000000u
+
+struct AcAutomaton {
+	//trie while adding: first child and next sibling of a state, and the
+	//byte leading to it. 0 means none, root is never a child. freed by
+	//ac_compile.
+	uint32_t* child,* sibling;
+	unsigned char* byte;
+	//after ac_compile it is the full goto function over byte classes,
+	//next[row+cls[byte]]. bytes no pattern uses share class 0, so a row
+	//costs only the distinct bytes of patterns, not 256. an entry is the row
+	//of the next state, state*nclass, so search needs no multiply, with
+	//AC_OUT set when that state has an output.
+	uint32_t* next;
+	unsigned char cls[256];
+	int nclass;
+	//longest pattern which ends at the state, that gives the leftmost start
+	uint32_t* out_len;
+	int* out_pat;
+	size_t nstate,cap;
+	int npat;
+	size_t max_len;
+};
+
+static int grow(void** p,size_t size)
+{
+	void* n = realloc(*p,size);
+	if(n==NULL) return -1;
+	*p = n;
+	return 0;
+}
+static long new_state(AcAutomaton* ac,unsigned char c)
+{
+	if(ac->nstate == ac->cap){
+		size_t cap = ac->cap*2;
+		if(grow((void**)&ac->child,sizeof(*ac->child)*cap)
+				|| grow((void**)&ac->sibling,sizeof(*ac->sibling)*cap)
+				|| grow((void**)&ac->byte,sizeof(*ac->byte)*cap)
+				|| grow((void**)&ac->out_len,sizeof(*ac->out_len)*cap)
+				|| grow((void**)&ac->out_pat,sizeof(*ac->out_pat)*cap))
+			return -1;
+		ac->cap = cap;
+	}
+	ac->child[ac->nstate] = 0;
+	ac->sibling[ac->nstate] = 0;
+	ac->byte[ac->nstate] = c;
+	ac->out_len[ac->nstate] = 0;
+	ac->out_pat[ac->nstate] = -1;
+	return ac->nstate++;
+}
+
+AcAutomaton* ac_new()
+{
+	AcAutomaton* ac = calloc(1,sizeof(*ac));
+	if(ac==NULL) return NULL;
+	ac->cap = 64;
+	ac->child = malloc(sizeof(*ac->child)*ac->cap);
+	ac->sibling = malloc(sizeof(*ac->sibling)*ac->cap);
+	ac->byte = malloc(sizeof(*ac->byte)*ac->cap);
+	ac->out_len = malloc(sizeof(*ac->out_len)*ac->cap);
+	ac->out_pat = malloc(sizeof(*ac->out_pat)*ac->cap);
+	if(!ac->child||!ac->sibling||!ac->byte||!ac->out_len||!ac->out_pat||new_state(ac,0)<0){
+		ac_free(ac);
+		return NULL;
+	}
+	return ac;
+}
+
+void ac_free(AcAutomaton* ac)
+{
+	if(ac==NULL) return;
+	free(ac->child);
+	free(ac->sibling);
+	free(ac->byte);
+	free(ac->next);
+	free(ac->out_len);
+	free(ac->out_pat);
+	free(ac);
+}
+
+int ac_add(AcAutomaton* ac,const char* s,size_t len)
+{
+	const unsigned char* p = (const unsigned char*)s;
+	size_t i;
+	long state = 0,n;
+	if(len==0 || ac->child==NULL) return -1;
+	for(i=0;i<len;i++){
+		for(n=ac->child[state];n && ac->byte[n]!=p[i];n=ac->sibling[n]);
+		if(n==0){
+			if((n = new_state(ac,p[i]))<0) return -1;
+			ac->sibling[n] = ac->child[state];
+			ac->child[state] = n;
+		}
+		state = n;
+	}
+	//duplicated pattern keeps its first priority
+	if(ac->out_pat[state]!=-1) return ac->out_pat[state];
+	ac->out_len[state] = len;
+	ac->out_pat[state] = ac->npat;
+	if(len>ac->max_len) ac->max_len = len;
+	return ac->npat++;
+}
+
+void ac_compile(AcAutomaton* ac)
+{
+	uint32_t* fail = calloc(ac->nstate,sizeof(*fail));
+	uint32_t* queue = malloc(sizeof(*queue)*ac->nstate);
+	size_t head = 0,tail = 0,s;
+	uint32_t n;
+	int c,k = ac->nclass = 1;
+	memset(ac->cls,0,sizeof(ac->cls));
+	for(s=1;s<ac->nstate;s++) ac->cls[ac->byte[s]] = 1;
+	for(c=0;c<256;c++) if(ac->cls[c]) ac->cls[c] = k++;
+	ac->nclass = k;
+	//rows must stay below AC_OUT
+	ac->next = ac->nstate*k<AC_OUT?calloc(ac->nstate*k,sizeof(*ac->next)):NULL;
+	if(!fail||!queue||!ac->next){
+		//leave an automaton which never matches
+		free(ac->next);
+		ac->next = calloc(k,sizeof(*ac->next));
+		ac->nstate = 1;
+		goto done;
+	}
+	for(s=0;s<ac->nstate;s++)
+		for(n=ac->child[s];n;n=ac->sibling[n])
+			ac->next[s*k+ac->cls[ac->byte[n]]] = n;
+	for(c=0;c<k;c++){
+		n = ac->next[c];
+		if(n){ fail[n] = 0; queue[tail++] = n; }
+	}
+	//bfs, so fail state of s is always finished before s
+	while(head<tail){
+		s = queue[head++];
+		for(c=0;c<k;c++){
+			n = ac->next[s*k+c];
+			if(n==0){
+				ac->next[s*k+c] = ac->next[fail[s]*k+c];
+				continue;
+			}
+			fail[n] = ac->next[fail[s]*k+c];
+			//own pattern is always the longest output
+			if(ac->out_pat[n]==-1){
+				ac->out_len[n] = ac->out_len[fail[n]];
+				ac->out_pat[n] = ac->out_pat[fail[n]];
+			}
+			queue[tail++] = n;
+		}
+	}
+	for(s=0;s<ac->nstate*k;s++){
+		n = ac->next[s];
+		ac->next[s] = n*k|(ac->out_pat[n]!=-1?AC_OUT:0);
+	}
+done:
+	free(fail);
+	free(queue);
+	free(ac->child);
+	free(ac->sibling);
+	free(ac->byte);
+	ac->child = ac->sibling = NULL;
+	ac->byte = NULL;
+}
+
+int ac_search(const AcAutomaton* ac,const char* str,const char** begin,const char** end)
+{
+	const unsigned char* p = (const unsigned char*)str;
+	size_t i,start = 0,best_end = 0;
+	uint32_t row = 0,v,state;
+	int best = -1;
+	for(i=0;p[i];i++){
+		v = ac->next[row+ac->cls[p[i]]];
+		row = v&~AC_OUT;
+		if(v&AC_OUT){
+			state = row/ac->nclass;
+			size_t s = i+1-ac->out_len[state];
+			if(best==-1 || s<start || (s==start && ac->out_pat[state]<best)){
+				start = s;
+				best = ac->out_pat[state];
+				best_end = i+1;
+			}
+		}
+		//no later match could start at or before the best one
+		if(best!=-1 && i+2>start+ac->max_len) break;
+	}
+	*begin = best==-1?NULL:str+start;
+	*end = best==-1?NULL:str+best_end;
+	return best;
+}
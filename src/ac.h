@@ -0,0 +1,26 @@
+#ifndef AC_H_H
+#define AC_H_H
+#include <stddef.h>
+
+/**
+ * a small Aho-Corasick automaton over bytes.
+ * patterns are prioritized by the order they are added, so a search gives
+ * the same result as the ordered alternation "p0|p1|p2..." of a regexp:
+ * the leftmost match wins, on the same position the earlier pattern wins.
+ */
+typedef struct AcAutomaton AcAutomaton;
+
+AcAutomaton* ac_new();
+void ac_free(AcAutomaton* ac);
+/** add pattern s[0,len) , return its priority or -1 when it can't be added */
+int ac_add(AcAutomaton* ac,const char* s,size_t len);
+/** build the transition table, call it once after all ac_add */
+void ac_compile(AcAutomaton* ac);
+/**
+ * search str in a single pass.
+ * return priority of the match and set [*begin,*end),
+ * or return -1 and set them NULL.
+ */
+int ac_search(const AcAutomaton* ac,const char* str,const char** begin,const char** end);
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * bench_index: time buddy lookups by uin, the fast index against the lwqq
+ * linear walk it replaces.
+ *
+ * usage: bench_index [-n lookups] [buddies...]
+ *
+ * for every buddy count, 100 1000 5000 by default, a friend list of random
+ * 10 digit uins is built and looked up in random order through:
+ *  - linear_walk : lwqq_buddy_find_buddy_by_uin
+ *  - num_index : num_index_find, as find_buddy_by_uin does
+ * each prints one json line with lookups/s and ns per lookup.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <lwqq.h>
+#include "numindex.h"
+
+#define BENCH_LOOKUPS 200000
+
+static unsigned long long now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+static void bench_report(const char* name,int buddies,long lookups,unsigned long long ns)
+{
+	double sec = ns/1e9;
+	printf("{\"bench\":\"%s\",\"buddies\":%d,\"lookups\":%ld,\"seconds\":%.6f,"
+			"\"lookups_s\":%.0f,\"ns_per_lookup\":%.1f}\n",
+			name, buddies, lookups, sec, sec>0?lookups/sec:0, (double)ns/lookups);
+	fflush(stdout);
+}
+
+static void bench_buddies(int n,long lookups)
+{
+	LwqqClient* lc = s_malloc0(sizeof(*lc));
+	LwqqBuddy* buddies = s_malloc0(sizeof(*buddies)*n);
+	NumIndex idx;
+	unsigned seed = n;
+	const void* found = NULL;
+	unsigned long long t0;
+	long i;
+	int k;
+	LIST_INIT(&lc->friends);
+	num_index_init(&idx, n);
+	for(k=0;k<n;k++){
+		char uin[16];
+		seed = seed*1103515245+12345;
+		snprintf(uin, sizeof(uin), "%u", 1000000000u+seed%3000000000u);
+		buddies[k].uin = s_strdup(uin);
+		LIST_INSERT_HEAD(&lc->friends, &buddies[k], entries);
+		num_index_insert(&idx, uin, 0, &buddies[k]);
+	}
+	//the same random order for both, a walk costs n/2 compares on average
+	int* order = s_malloc0(sizeof(*order)*lookups);
+	for(i=0;i<lookups;i++){
+		seed = seed*1103515245+12345;
+		order[i] = (seed>>8)%n;
+	}
+
+	//the walk is too slow for every lookup on big lists
+	long walks = lookups/(n/100+1);
+	t0 = now_ns();
+	for(i=0;i<walks;i++)
+		found = lwqq_buddy_find_buddy_by_uin(lc, buddies[order[i]].uin);
+	bench_report("linear_walk", n, walks, now_ns()-t0);
+
+	t0 = now_ns();
+	for(i=0;i<lookups;i++)
+		found = num_index_find(&idx, buddies[order[i]].uin)->node;
+	bench_report("num_index", n, lookups, now_ns()-t0);
+	if(found == NULL) fprintf(stderr, "lookup missed\n");
+
+	for(k=0;k<n;k++) s_free(buddies[k].uin);
+	s_free(order);
+	s_free(buddies);
+	s_free(lc);
+	num_index_free(&idx);
+}
+
+int main(int argc,char** argv)
+{
+	static const int defaults[] = {100, 1000, 5000};
+	long lookups = BENCH_LOOKUPS;
+	int i,n = 0;
+	for(i=1;i<argc;i++)
+		if(strcmp(argv[i],"-n")==0 && i+1<argc) lookups = atol(argv[++i]);
+	if(lookups<=0) return 1;
+	for(i=1;i<argc;i++){
+		if(strcmp(argv[i],"-n")==0) i++;
+		else if(atoi(argv[i])>0){
+			bench_buddies(atoi(argv[i]), lookups);
+			n++;
+		}
+	}
+	if(n == 0)
+		for(i=0;i<sizeof(defaults)/sizeof(defaults[0]);i++)
+			bench_buddies(defaults[i], lookups);
+	return 0;
+}
@@ -0,0 +1,155 @@
+/**
+ * bench_purple: the part of libpurple translate.c calls, for bench_translate
+ * and test_translate.
+ *
+ * imgstore keeps images in memory by id like purple does, so emoji and
+ * received picture paths run the same ref/unref work. smileys, signals and
+ * timers do nothing: the bench never writes to a conversation.
+ */
+#include <string.h>
+#include <imgstore.h>
+#include <smiley.h>
+#include <signals.h>
+#include <conversation.h>
+#include <eventloop.h>
+#include <account.h>
+
+struct _PurpleStoredImage {
+	int id;
+	int ref;
+	gpointer data;
+	size_t size;
+	char* filename;
+};
+
+static GHashTable* img_by_id;
+static int img_last_id;
+static int imgstore_handle;
+static int conversations_handle;
+
+static PurpleStoredImage* img_new(gpointer data,size_t size,const char* filename)
+{
+	PurpleStoredImage* img;
+	if(data == NULL || size == 0) return NULL;
+	if(img_by_id == NULL)
+		img_by_id = g_hash_table_new(g_direct_hash, g_direct_equal);
+	img = g_new0(PurpleStoredImage, 1);
+	img->id = ++img_last_id;
+	img->ref = 1;
+	img->data = data;
+	img->size = size;
+	img->filename = g_strdup(filename);
+	g_hash_table_insert(img_by_id, GINT_TO_POINTER(img->id), img);
+	return img;
+}
+static void img_unref(PurpleStoredImage* img)
+{
+	if(img == NULL || --img->ref>0) return;
+	g_hash_table_remove(img_by_id, GINT_TO_POINTER(img->id));
+	g_free(img->data);
+	g_free(img->filename);
+	g_free(img);
+}
+
+PurpleStoredImage* purple_imgstore_add(gpointer data, size_t size, const char *filename)
+{
+	return img_new(data, size, filename);
+}
+int purple_imgstore_add_with_id(gpointer data, size_t size, const char *filename)
+{
+	PurpleStoredImage* img = img_new(data, size, filename);
+	return img?img->id:0;
+}
+PurpleStoredImage* purple_imgstore_find_by_id(int id)
+{
+	return img_by_id?g_hash_table_lookup(img_by_id, GINT_TO_POINTER(id)):NULL;
+}
+gconstpointer purple_imgstore_get_data(PurpleStoredImage *img)
+{
+	return img->data;
+}
+size_t purple_imgstore_get_size(PurpleStoredImage *img)
+{
+	return img->size;
+}
+const char* purple_imgstore_get_filename(const PurpleStoredImage *img)
+{
+	return img->filename;
+}
+void purple_imgstore_ref_by_id(int id)
+{
+	PurpleStoredImage* img = purple_imgstore_find_by_id(id);
+	if(img) img->ref++;
+}
+void purple_imgstore_unref_by_id(int id)
+{
+	img_unref(purple_imgstore_find_by_id(id));
+}
+void* purple_imgstore_get_handle(void)
+{
+	return &imgstore_handle;
+}
+
+//a smiley can't be built without a conversation window, report it failed
+PurpleSmiley* purple_smiley_new(PurpleStoredImage *img, const char *shortcut)
+{
+	img_unref(img);
+	return NULL;
+}
+PurpleSmiley* purple_smileys_find_by_shortcut(const char *shortcut)
+{
+	return NULL;
+}
+const char* purple_smiley_get_shortcut(const PurpleSmiley *smiley)
+{
+	return NULL;
+}
+gconstpointer purple_smiley_get_data(const PurpleSmiley *smiley, size_t *len)
+{
+	if(len) *len = 0;
+	return NULL;
+}
+void purple_smiley_delete(PurpleSmiley *smiley)
+{
+}
+GList* purple_smileys_get_all(void)
+{
+	return NULL;
+}
+gboolean purple_conv_custom_smiley_add(PurpleConversation *conv, const char *smile,
+		const char *cksum_type, const char *chksum, gboolean remote)
+{
+	return FALSE;
+}
+void purple_conv_custom_smiley_write(PurpleConversation *conv, const char *smile,
+		const guchar *data, gsize size)
+{
+}
+void purple_conv_custom_smiley_close(PurpleConversation *conv, const char *smile)
+{
+}
+
+gulong purple_signal_connect(void *instance, const char *signal, void *handle,
+		PurpleCallback func, void *data)
+{
+	return 1;
+}
+void purple_signals_disconnect_by_handle(void *handle)
+{
+}
+void* purple_conversations_get_handle(void)
+{
+	return &conversations_handle;
+}
+guint purple_timeout_add(guint interval, GSourceFunc function, gpointer data)
+{
+	return 0;
+}
+gboolean purple_timeout_remove(guint handle)
+{
+	return TRUE;
+}
+const char* purple_account_get_protocol_id(const PurpleAccount *account)
+{
+	return "prpl-webqq";
+}
@@ -0,0 +1,341 @@
+/**
+ * bench_translate: time translate.c outside of pidgin.
+ *
+ * usage: bench_translate [-n rounds] [-l bytes] [-p shortcuts] [corpus.txt]
+ *
+ * every message of the corpus, one per line, or the builtin one when no file
+ * is given, runs through:
+ *  - to_struct : translate_message_to_struct, purple html to LwqqMsg
+ *  - to_message : translate_struct_to_message, LwqqMsg back to html
+ *  - group_message : (#seq) prefix and translate_struct_append_message
+ *  - html_symbol : translate_to_html_symbol
+ *  - to_struct_long, html_symbol_long : the same on one message of the
+ *    corpus joined to -l bytes, 64 KB by default
+ *  - to_struct_markup : translate_message_to_struct on -l bytes of pidgin
+ *    formatting without smileys, it times the markup lexer
+ *  - smiley_build, smiley_scan : the smiley automaton alone, built from -p
+ *    synthetic CJK shortcuts, 5000 by default, and searched over the long
+ *    message
+ * each prints one json line with MB/s, msgs/s, allocations per message and
+ * p50/p99 latency of a single message in ns. libpurple is replaced by
+ * bench_purple.c, so it runs without pidgin.
+ *
+ * no real chat log is shipped, even anonymized the text is other people's
+ * messages. the builtin corpus mimics their mix, pass an exported log of your
+ * own to measure on real traffic.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "translate.h"
+#include "ac.h"
+
+#define BENCH_ROUNDS 2000
+#define BENCH_LONG 65536
+#define BENCH_PACK 5000
+
+static const char* builtin_corpus[] = {
+	"hello",
+	"ok :) see you tomorrow",
+	"今天晚上一起吃饭吗？我们在老地方等你 :微笑: :wx:",
+	"<FONT COLOR=\"#ff0000\"><B>urgent</B></FONT> please check the build &amp; reply",
+	"<a href=\"http://example.com/a:)b\">http://example.com/a:)b</a> :) 8-) :|",
+	"&lt;3 &quot;quoted&quot; it&apos;s fine :B :色: :se: 😀😁 ok",
+	"<FONT FACE=\"宋体\" SIZE=\"3\">中文 English 混合 :撇嘴: text with a longer run of plain "
+		"words which does not contain any smiley at all, as most long messages do, "
+		"and it goes on for a while so the clean span paths get some work</FONT>",
+	":) :) :) :) :) :) :) :) :) :) :) :) :) :) :) :) :) :) :) :) :) :) :) :) :)",
+};
+
+static const char* markup_piece = "<FONT FACE=\"Sans\" SIZE=\"3\" COLOR=\"#1a2b3c\">"
+	"<B><I>formatted</I></B> text &amp; more &lt;tags&gt;<BR><U>underlined</U></FONT>";
+
+//counted while a bench is inside the measured call, see malloc below
+static int alloc_counting;
+static unsigned long alloc_count;
+
+#ifdef HAVE_LIBC_MALLOC
+extern void* __libc_malloc(size_t);
+extern void* __libc_calloc(size_t,size_t);
+extern void* __libc_realloc(void*,size_t);
+void* malloc(size_t n)
+{
+	if(alloc_counting) alloc_count++;
+	return __libc_malloc(n);
+}
+void* calloc(size_t n,size_t m)
+{
+	if(alloc_counting) alloc_count++;
+	return __libc_calloc(n,m);
+}
+void* realloc(void* p,size_t n)
+{
+	if(alloc_counting) alloc_count++;
+	return __libc_realloc(p,n);
+}
+#define ALLOC_COUNTED 1
+#else
+#define ALLOC_COUNTED 0
+#endif
+
+struct bench {
+	const char* name;
+	unsigned long msgs;
+	unsigned long long bytes;
+	unsigned long long ns;
+	unsigned long allocs;
+	unsigned long long* lat;
+	size_t nlat;
+};
+
+static unsigned long long now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+#define BENCH_BEGIN(b) \
+	unsigned long long t0_ = now_ns(); \
+	alloc_counting = 1;
+#define BENCH_END(b,len) \
+	alloc_counting = 0; \
+	(b)->lat[(b)->nlat] = now_ns()-t0_; \
+	(b)->ns += (b)->lat[(b)->nlat++]; \
+	(b)->bytes += len; \
+	(b)->msgs++;
+
+static int cmp_ull(const void* a,const void* b)
+{
+	unsigned long long x = *(const unsigned long long*)a,y = *(const unsigned long long*)b;
+	return x<y?-1:x>y;
+}
+static void bench_report(struct bench* b)
+{
+	double sec = b->ns/1e9;
+	qsort(b->lat, b->nlat, sizeof(*b->lat), cmp_ull);
+	printf("{\"bench\":\"%s\",\"msgs\":%lu,\"bytes\":%llu,\"seconds\":%.6f,"
+			"\"mb_s\":%.2f,\"msgs_s\":%.0f,\"allocs_per_msg\":%.2f,"
+			"\"p50_ns\":%llu,\"p99_ns\":%llu}\n",
+			b->name, b->msgs, b->bytes, sec,
+			sec>0?b->bytes/sec/1e6:0, sec>0?b->msgs/sec:0,
+			ALLOC_COUNTED?(double)b->allocs/b->msgs:-1.0,
+			b->lat[b->nlat/2], b->lat[b->nlat*99/100]);
+	fflush(stdout);
+}
+
+//the corpus joined by spaces and repeated to at least size bytes
+static char* join_corpus(const char** corpus,int n,size_t size)
+{
+	struct ds buf = ds_initializer;
+	size_t len = 0;
+	int i = 0;
+	while(len<size){
+		if(len) ds_cat(buf, " ");
+		ds_cat(buf, corpus[i++%n]);
+		len = strlen(ds_c_str(buf));
+	}
+	char* ret = ds_c_str(buf);
+	buf.d = NULL;
+	ds_free(buf);
+	return ret;
+}
+//n shortcuts like ":丐乂乃:", 2 to 4 random CJK characters, as a big local
+//smiley.txt has
+static char** make_pack(int n)
+{
+	char** pack = s_malloc0(sizeof(char*)*n);
+	unsigned seed = 1;
+	int i,j,k;
+	for(i=0;i<n;i++){
+		char* p = pack[i] = s_malloc0(16);
+		*p++ = ':';
+		for(j=0,k=2+(seed>>16)%3;j<k;j++){
+			unsigned cp;
+			seed = seed*1103515245+12345;
+			cp = 0x4e00+(seed>>16)%3000;
+			*p++ = 0xE0|cp>>12;
+			*p++ = 0x80|(cp>>6&0x3F);
+			*p++ = 0x80|(cp&0x3F);
+		}
+		*p = ':';
+	}
+	return pack;
+}
+static char** load_corpus(const char* file,int* n)
+{
+	char** lines = NULL;
+	char buf[8192];
+	int cap = 0;
+	FILE* f = fopen(file, "r");
+	*n = 0;
+	if(f == NULL) return NULL;
+	while(fgets(buf, sizeof(buf), f)){
+		buf[strcspn(buf, "\r\n")] = '\0';
+		if(buf[0] == '\0') continue;
+		if(*n == cap) lines = s_realloc(lines, sizeof(char*)*(cap = cap?cap*2:64));
+		lines[(*n)++] = s_strdup(buf);
+	}
+	fclose(f);
+	return lines;
+}
+
+int main(int argc,char** argv)
+{
+	int rounds = BENCH_ROUNDS,n,i,r;
+	size_t long_size = BENCH_LONG;
+	int pack_size = BENCH_PACK;
+	const char** corpus = builtin_corpus;
+	char** loaded = NULL;
+	for(i=1;i<argc;i++){
+		if(strcmp(argv[i],"-n")==0 && i+1<argc) rounds = atoi(argv[++i]);
+		else if(strcmp(argv[i],"-l")==0 && i+1<argc) long_size = atoi(argv[++i]);
+		else if(strcmp(argv[i],"-p")==0 && i+1<argc) pack_size = atoi(argv[++i]);
+		else if((loaded = load_corpus(argv[i], &n)) == NULL){
+			fprintf(stderr, "can't read corpus %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if(loaded) corpus = (const char**)loaded;
+	else n = sizeof(builtin_corpus)/sizeof(builtin_corpus[0]);
+	if(rounds<=0 || n<=0 || long_size==0 || pack_size<0) return 1;
+	char* long_msg = join_corpus(corpus, n, long_size);
+
+	qq_account* ac = s_malloc0(sizeof(*ac));
+	ac->translator = qq_translator_ref();
+
+	struct bench b;
+	LwqqMsgMessage** parsed = s_malloc0(sizeof(*parsed)*n);
+#define BENCH_INIT(nm) \
+	memset(&b, 0, sizeof(b)); \
+	b.name = nm; \
+	b.lat = s_malloc0(sizeof(*b.lat)*(size_t)rounds*n);
+#define BENCH_DONE() \
+	b.allocs = alloc_count; \
+	alloc_count = 0; \
+	bench_report(&b); \
+	s_free(b.lat);
+
+	alloc_count = 0;
+	BENCH_INIT("to_struct");
+	for(r=0;r<rounds;r++){
+		for(i=0;i<n;i++){
+			LwqqMsg* msg = lwqq_msg_new(LWQQ_MS_BUDDY_MSG);
+			BENCH_BEGIN(&b);
+			translate_message_to_struct(ac->translator, "10000", corpus[i], msg, 0);
+			BENCH_END(&b, strlen(corpus[i]));
+			if(r == 0) parsed[i] = (LwqqMsgMessage*)msg;
+			else lwqq_msg_free(msg);
+		}
+	}
+	BENCH_DONE();
+
+	//received message carries a font, so the font header is rendered too
+	for(i=0;i<n;i++){
+		parsed[i]->f_name = s_strdup("宋体");
+		parsed[i]->f_size = 10;
+		strcpy(parsed[i]->f_color, "000000");
+	}
+	BENCH_INIT("to_message");
+	for(r=0;r<rounds;r++){
+		for(i=0;i<n;i++){
+			BENCH_BEGIN(&b);
+			struct ds s = translate_struct_to_message(ac, parsed[i], PURPLE_MESSAGE_RECV);
+			BENCH_END(&b, ds_c_str(s)?strlen(ds_c_str(s)):0);
+			ds_free(s);
+		}
+	}
+	BENCH_DONE();
+
+	//group message is rendered after its (#seq) prefix in the same buffer
+	BENCH_INIT("group_message");
+	for(r=0;r<rounds;r++){
+		for(i=0;i<n;i++){
+			struct ds s = ds_initializer;
+			BENCH_BEGIN(&b);
+			ds_cat(s, "(#3)");
+			translate_struct_append_message(ac, parsed[i], PURPLE_MESSAGE_RECV, &s);
+			BENCH_END(&b, strlen(ds_c_str(s)));
+			ds_free(s);
+		}
+	}
+	BENCH_DONE();
+
+	BENCH_INIT("html_symbol");
+	for(r=0;r<rounds;r++){
+		for(i=0;i<n;i++){
+			BENCH_BEGIN(&b);
+			char* s = translate_to_html_symbol(corpus[i]);
+			BENCH_END(&b, strlen(corpus[i]));
+			s_free(s);
+		}
+	}
+	BENCH_DONE();
+
+	//long messages run once per round
+	BENCH_INIT("to_struct_long");
+	for(r=0;r<rounds;r++){
+		LwqqMsg* msg = lwqq_msg_new(LWQQ_MS_BUDDY_MSG);
+		BENCH_BEGIN(&b);
+		translate_message_to_struct(ac->translator, "10000", long_msg, msg, 0);
+		BENCH_END(&b, strlen(long_msg));
+		lwqq_msg_free(msg);
+	}
+	BENCH_DONE();
+
+	char* markup_msg = join_corpus(&markup_piece, 1, long_size);
+	BENCH_INIT("to_struct_markup");
+	for(r=0;r<rounds;r++){
+		LwqqMsg* msg = lwqq_msg_new(LWQQ_MS_BUDDY_MSG);
+		BENCH_BEGIN(&b);
+		translate_message_to_struct(ac->translator, "10000", markup_msg, msg, 0);
+		BENCH_END(&b, strlen(markup_msg));
+		lwqq_msg_free(msg);
+	}
+	BENCH_DONE();
+	s_free(markup_msg);
+
+	BENCH_INIT("html_symbol_long");
+	for(r=0;r<rounds;r++){
+		BENCH_BEGIN(&b);
+		char* s = translate_to_html_symbol(long_msg);
+		BENCH_END(&b, strlen(long_msg));
+		s_free(s);
+	}
+	BENCH_DONE();
+
+	//built once, a round of smiley_scan searches the whole long message
+	char** pack = make_pack(pack_size);
+	AcAutomaton* smiley_ac = ac_new();
+	size_t pack_bytes = 0;
+	for(i=0;i<pack_size;i++) pack_bytes += strlen(pack[i]);
+	BENCH_INIT("smiley_build");
+	BENCH_BEGIN(&b);
+	for(i=0;i<pack_size;i++) ac_add(smiley_ac, pack[i], strlen(pack[i]));
+	ac_compile(smiley_ac);
+	BENCH_END(&b, pack_bytes);
+	BENCH_DONE();
+	BENCH_INIT("smiley_scan");
+	for(r=0;r<rounds;r++){
+		const char* p = long_msg,*mb,*me;
+		BENCH_BEGIN(&b);
+		while(ac_search(smiley_ac, p, &mb, &me)>=0) p = me;
+		BENCH_END(&b, strlen(long_msg));
+	}
+	BENCH_DONE();
+	ac_free(smiley_ac);
+	for(i=0;i<pack_size;i++) s_free(pack[i]);
+	s_free(pack);
+
+	s_free(long_msg);
+	for(i=0;i<n;i++) lwqq_msg_free((LwqqMsg*)parsed[i]);
+	s_free(parsed);
+	translate_font_cache_free(ac);
+	qq_translator_unref(ac->translator);
+	s_free(ac);
+	if(loaded){
+		for(i=0;i<n;i++) s_free(loaded[i]);
+		s_free(loaded);
+	}
+	return 0;
+}
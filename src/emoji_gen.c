@@ -0,0 +1,178 @@
+/**
+ * emoji_gen: index res/emoji at build time into emoji_table.h.
+ *
+ * usage: emoji_gen <emoji.list> <emoji_table.h>
+ *
+ * emoji.list holds one png name per line, named by its codepoint sequence
+ * in hex, like 1f1e8-1f1f3.png. emitted:
+ *  - emoji_table[] : (first,second) codepoints and file, sorted by them,
+ *    second is 0 for a single codepoint emoji. vs16 is set when it is only
+ *    an emoji with U+FE0F: the first codepoint is shown as text by default,
+ *    like © or ™, or it is a keycap
+ *  - emoji_lead[] : utf-8 lead bytes which could start an emoji or its
+ *    keycap mark U+20E3
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define MAX_LINE 256
+#define KEYCAP 0x20e3
+//the lead bytes translate.c prefilters with, see emoji_search
+#define IS_KNOWN_LEAD(c) ((c)==0xC2||(c)==0xE2||(c)==0xE3||(c)>=0xF0)
+
+struct emoji {
+	uint32_t cp[2];
+	char* file;
+	int vs16;
+};
+//Emoji_Presentation=Yes of emoji-data.txt below U+1F000, the rest of the
+//BMP is text by default
+static const uint32_t bmp_emoji_presentation[][2] = {
+	{0x231a,0x231b},{0x23e9,0x23ec},{0x23f0,0x23f0},{0x23f3,0x23f3},
+	{0x25fd,0x25fe},{0x2614,0x2615},{0x2648,0x2653},{0x267f,0x267f},
+	{0x2693,0x2693},{0x26a1,0x26a1},{0x26aa,0x26ab},{0x26bd,0x26be},
+	{0x26c4,0x26c5},{0x26ce,0x26ce},{0x26d4,0x26d4},{0x26ea,0x26ea},
+	{0x26f2,0x26f3},{0x26f5,0x26f5},{0x26fa,0x26fa},{0x26fd,0x26fd},
+	{0x2705,0x2705},{0x270a,0x270b},{0x2728,0x2728},{0x274c,0x274c},
+	{0x274e,0x274e},{0x2753,0x2755},{0x2757,0x2757},{0x2795,0x2797},
+	{0x27b0,0x27b0},{0x27bf,0x27bf},{0x2b1b,0x2b1c},{0x2b50,0x2b50},
+	{0x2b55,0x2b55},
+};
+//Emoji_Presentation=No of emoji-data.txt from U+1F000, the rest is emoji
+static const uint32_t smp_text_presentation[][2] = {
+	{0x1f170,0x1f171},{0x1f17e,0x1f17f},{0x1f202,0x1f202},{0x1f237,0x1f237},
+	{0x1f321,0x1f321},{0x1f324,0x1f32c},{0x1f336,0x1f336},{0x1f37d,0x1f37d},
+	{0x1f396,0x1f397},{0x1f399,0x1f39b},{0x1f39e,0x1f39f},{0x1f3cb,0x1f3ce},
+	{0x1f3d4,0x1f3df},{0x1f3f3,0x1f3f3},{0x1f3f5,0x1f3f5},{0x1f3f7,0x1f3f7},
+	{0x1f43f,0x1f43f},{0x1f441,0x1f441},{0x1f4fd,0x1f4fd},{0x1f549,0x1f54a},
+	{0x1f56f,0x1f570},{0x1f573,0x1f579},{0x1f587,0x1f587},{0x1f58a,0x1f58d},
+	{0x1f590,0x1f590},{0x1f5a5,0x1f5a5},{0x1f5a8,0x1f5a8},{0x1f5b1,0x1f5b2},
+	{0x1f5bc,0x1f5bc},{0x1f5c2,0x1f5c4},{0x1f5d1,0x1f5d3},{0x1f5dc,0x1f5de},
+	{0x1f5e1,0x1f5e1},{0x1f5e3,0x1f5e3},{0x1f5e8,0x1f5e8},{0x1f5ef,0x1f5ef},
+	{0x1f5f3,0x1f5f3},{0x1f5fa,0x1f5fa},{0x1f6cb,0x1f6cb},{0x1f6cd,0x1f6cf},
+	{0x1f6e0,0x1f6e5},{0x1f6e9,0x1f6e9},{0x1f6f0,0x1f6f0},{0x1f6f3,0x1f6f3},
+};
+#define COUNT(a) (sizeof(a)/sizeof(a[0]))
+static struct emoji* list;
+static size_t nlist,list_cap;
+
+static void* xrealloc(void* p,size_t sz)
+{
+	p = realloc(p,sz);
+	if(p==NULL){fprintf(stderr,"emoji_gen: out of memory\n");exit(1);}
+	return p;
+}
+static int cmp_emoji(const void* a,const void* b)
+{
+	const struct emoji* x = a,*y = b;
+	if(x->cp[0]!=y->cp[0]) return x->cp[0]<y->cp[0]?-1:1;
+	if(x->cp[1]!=y->cp[1]) return x->cp[1]<y->cp[1]?-1:1;
+	return 0;
+}
+static unsigned char utf8_lead(uint32_t cp)
+{
+	if(cp<0x80) return cp;
+	if(cp<0x800) return 0xC0|cp>>6;
+	if(cp<0x10000) return 0xE0|cp>>12;
+	return 0xF0|cp>>18;
+}
+static int in_ranges(const uint32_t r[][2],size_t n,uint32_t cp)
+{
+	size_t i;
+	for(i=0;i<n;i++)
+		if(cp>=r[i][0] && cp<=r[i][1]) return 1;
+	return 0;
+}
+static int text_by_default(uint32_t cp)
+{
+	if(cp<0x1f000) return !in_ranges(bmp_emoji_presentation,COUNT(bmp_emoji_presentation),cp);
+	return in_ranges(smp_text_presentation,COUNT(smp_text_presentation),cp);
+}
+static int parse(FILE* f)
+{
+	char line[MAX_LINE];
+	while(fgets(line,sizeof(line),f)){
+		struct emoji e = {{0,0},NULL,0};
+		char* p = line,*end;
+		size_t len = strcspn(line,"\r\n");
+		line[len] = '\0';
+		if(len==0) continue;
+		if(len<=4 || strcmp(line+len-4,".png")!=0){
+			fprintf(stderr,"emoji_gen: not a png: %s\n",line);
+			return 1;
+		}
+		e.cp[0] = strtoul(p,&end,16);
+		if(end==p){fprintf(stderr,"emoji_gen: bad name %s\n",line);return 1;}
+		if(*end=='-'){
+			p = end+1;
+			e.cp[1] = strtoul(p,&end,16);
+			if(end==p){fprintf(stderr,"emoji_gen: bad name %s\n",line);return 1;}
+		}
+		if(strcmp(end,".png")!=0){
+			fprintf(stderr,"emoji_gen: longer than 2 codepoints: %s\n",line);
+			return 1;
+		}
+		e.vs16 = e.cp[1]==KEYCAP || text_by_default(e.cp[0]);
+		e.file = strcpy(xrealloc(NULL,len+1),line);
+		if(nlist==list_cap){
+			list_cap = list_cap?list_cap*2:1024;
+			list = xrealloc(list,sizeof(*list)*list_cap);
+		}
+		list[nlist++] = e;
+	}
+	return 0;
+}
+
+int main(int argc,char** argv)
+{
+	FILE *f,*o;
+	unsigned char lead[256] = {0};
+	size_t i;
+	if(argc!=3){
+		fprintf(stderr,"usage: %s <emoji.list> <emoji_table.h>\n",argv[0]);
+		return 1;
+	}
+	f = fopen(argv[1],"r");
+	if(f==NULL){perror(argv[1]);return 1;}
+	if(parse(f)) return 1;
+	fclose(f);
+	qsort(list,nlist,sizeof(*list),cmp_emoji);
+
+	for(i=0;i<nlist;i++){
+		//keycap starts with an ascii byte, it is found from U+20E3
+		uint32_t cp = list[i].cp[1]==KEYCAP?KEYCAP:list[i].cp[0];
+		unsigned char c = utf8_lead(cp);
+		if(!IS_KNOWN_LEAD(c)){
+			fprintf(stderr,"emoji_gen: %s needs a new lead byte 0x%X in emoji_search\n",list[i].file,c);
+			return 1;
+		}
+		if(list[i].cp[1] && list[i].cp[1]!=KEYCAP && utf8_lead(list[i].cp[1])<0x80){
+			fprintf(stderr,"emoji_gen: %s has an ascii second codepoint\n",list[i].file);
+			return 1;
+		}
+		lead[c] = 1;
+	}
+
+	o = fopen(argv[2],"w");
+	if(o==NULL){perror(argv[2]);return 1;}
+	fprintf(o,"//generated by emoji_gen from res/emoji, do not edit\n");
+	fprintf(o,"#ifndef EMOJI_TABLE_H_H\n#define EMOJI_TABLE_H_H\n");
+	fprintf(o,"#include <stdint.h>\n\n");
+	fprintf(o,"#define EMOJI_KEYCAP 0x%x\n",KEYCAP);
+	fprintf(o,"#define EMOJI_NUM %zu\n",nlist);
+	fprintf(o,"struct emoji_entry {uint32_t cp[2]; const char* file; int vs16;};\n");
+	fprintf(o,"static const struct emoji_entry emoji_table[%zu] = {\n",nlist?nlist:1);
+	for(i=0;i<nlist;i++)
+		fprintf(o,"\t{{0x%x, 0x%x}, \"%s\", %d},\n",list[i].cp[0],list[i].cp[1],list[i].file,list[i].vs16);
+	if(nlist==0) fprintf(o,"\t{{0, 0}, NULL, 0}\n");
+	fprintf(o,"};\n\n");
+	fprintf(o,"static const unsigned char emoji_lead[256] = {[0] = 0, ");
+	for(i=0;i<256;i++)
+		if(lead[i]) fprintf(o,"[0x%zX] = 1, ",i);
+	fprintf(o,"};\n\n");
+	fprintf(o,"#endif\n");
+	if(fclose(o)!=0){perror(argv[2]);return 1;}
+	return 0;
+}
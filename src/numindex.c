@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <string.h>
+#include "numindex.h"
+
+#define NUM_INDEX_MIN 16
+//1e19 doesn't fit, keep one digit below
+#define NUM_INDEX_MAX_DIGITS 19
+
+uint64_t num_index_key(const char* s)
+{
+	uint64_t k = 0;
+	int n;
+	if(s==NULL || *s<'1' || *s>'9') return 0;
+	for(n=0;s[n];n++){
+		if(s[n]<'0' || s[n]>'9' || n==NUM_INDEX_MAX_DIGITS) return 0;
+		k = k*10+(s[n]-'0');
+	}
+	return k;
+}
+//fibonacci hashing, the high bits of the product are well mixed
+static size_t slot_of(const NumIndex* idx,uint64_t key)
+{
+	return (size_t)((key*0x9E3779B97F4A7C15ULL)>>32) & idx->mask;
+}
+static NumIndexSlot* probe(const NumIndex* idx,uint64_t key)
+{
+	size_t i = slot_of(idx,key);
+	while(idx->slot[i].key && idx->slot[i].key!=key)
+		i = (i+1) & idx->mask;
+	return &idx->slot[i];
+}
+static void rehash(NumIndex* idx,size_t cap)
+{
+	NumIndexSlot* old = idx->slot;
+	size_t i,old_cap = old?idx->mask+1:0;
+	NumIndexSlot* slot = calloc(cap,sizeof(*slot));
+	//keep the old one, it still has free slots
+	if(slot==NULL) return;
+	idx->slot = slot;
+	idx->mask = cap-1;
+	for(i=0;i<old_cap;i++)
+		if(old[i].key) *probe(idx,old[i].key) = old[i];
+	free(old);
+}
+
+void num_index_init(NumIndex* idx,size_t n)
+{
+	idx->slot = NULL;
+	idx->mask = 0;
+	idx->count = 0;
+	num_index_reserve(idx,n);
+}
+void num_index_free(NumIndex* idx)
+{
+	free(idx->slot);
+	idx->slot = NULL;
+	idx->mask = 0;
+	idx->count = 0;
+}
+void num_index_reserve(NumIndex* idx,size_t n)
+{
+	size_t cap = NUM_INDEX_MIN;
+	//keep load factor under 3/4
+	while(cap/4*3 < n) cap *= 2;
+	if(idx->slot==NULL || cap > idx->mask+1)
+		rehash(idx,cap);
+}
+int num_index_insert(NumIndex* idx,const char* s,int type,const void* node)
+{
+	uint64_t key = num_index_key(s);
+	NumIndexSlot* slot;
+	if(key==0) return -1;
+	slot = probe(idx,key);
+	if(slot->key==0){
+		if((idx->count+1) > (idx->mask+1)/4*3){
+			num_index_reserve(idx,idx->count+1);
+			slot = probe(idx,key);
+		}
+		idx->count++;
+	}
+	slot->key = key;
+	slot->type = type;
+	slot->node = node;
+	return 0;
+}
+void num_index_remove(NumIndex* idx,const char* s)
+{
+	uint64_t key = num_index_key(s);
+	size_t i,j,home;
+	if(key==0) return;
+	i = probe(idx,key)-idx->slot;
+	if(idx->slot[i].key==0) return;
+	idx->count--;
+	//backward shift, so lookups never need tombstones
+	for(j=(i+1)&idx->mask; idx->slot[j].key; j=(j+1)&idx->mask){
+		home = slot_of(idx,idx->slot[j].key);
+		//move j to the hole when i lies cyclically in [home,j)
+		if(((j-home)&idx->mask) >= ((j-i)&idx->mask)){
+			idx->slot[i] = idx->slot[j];
+			i = j;
+		}
+	}
+	idx->slot[i].key = 0;
+	idx->slot[i].node = NULL;
+}
+const NumIndexSlot* num_index_find(const NumIndex* idx,const char* s)
+{
+	return num_index_find_key(idx,num_index_key(s));
+}
+const NumIndexSlot* num_index_find_key(const NumIndex* idx,uint64_t key)
+{
+	const NumIndexSlot* slot;
+	if(key==0) return NULL;
+	slot = probe(idx,key);
+	return slot->key?slot:NULL;
+}
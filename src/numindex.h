@@ -0,0 +1,41 @@
+#ifndef NUMINDEX_H_H
+#define NUMINDEX_H_H
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * open addressing hash table keyed by decimal ids. uin, gid and qqnumber
+ * of webqq are all decimal numbers, so they are parsed into 64 bit keys
+ * and entries are stored inline in the slot array, nothing is allocated
+ * per entry.
+ */
+typedef struct {
+	uint64_t key;///< 0 is a free slot
+	int type;
+	const void* node;
+} NumIndexSlot;
+typedef struct {
+	NumIndexSlot* slot;
+	size_t mask;///< capacity-1, capacity is a power of 2
+	size_t count;
+} NumIndex;
+
+/**
+ * key of decimal id s, or 0 when s isn't one. only the canonical form is
+ * accepted (no sign, no leading zero), so different strings never share
+ * a key.
+ */
+uint64_t num_index_key(const char* s);
+void num_index_init(NumIndex* idx,size_t n);
+void num_index_free(NumIndex* idx);
+/** make room for n entries in total, so inserting them never rehashes */
+void num_index_reserve(NumIndex* idx,size_t n);
+/** insert or replace entry of id s, return -1 if s isn't a decimal id */
+int num_index_insert(NumIndex* idx,const char* s,int type,const void* node);
+void num_index_remove(NumIndex* idx,const char* s);
+/** return entry of id s, or NULL */
+const NumIndexSlot* num_index_find(const NumIndex* idx,const char* s);
+/** like num_index_find, with the key parsed by num_index_key already */
+const NumIndexSlot* num_index_find_key(const NumIndex* idx,uint64_t key);
+
+#endif
@@ -1,4 +1,5 @@
 #include "qq_types.h"
+#include "translate.h"
 #include "smemory.h"
 #include "utility.h"
 #include <unistd.h>
@@ -63,23 +64,24 @@ LwqqStatus qq_status_from_str(const char* str)
 	return lwqq_status_from_str(str);
 }
 
-const char* qq_level_to_str(int level)
+const char* qq_level_to_str(int level,char* buf,size_t size)
 {
 	static const char* symbol[] = {"♔","⚙","☾","☆"};
 	static const int number[] = {64,16,4,1};
-	static char buf[128];
 	int l = level;
 	int repeat;
 	int i,j;
-	memset(buf,0,sizeof(buf));
+	size_t len = 0;
+	buf[0] = '\0';
 	for(i=0;i<4;i++){
 		repeat = l/number[i];
 		l=l%number[i];
-		for(j=0;j<repeat;j++){
-			strcat(buf,symbol[i]);
+		for(j=0;j<repeat && len+strlen(symbol[i])<size;j++){
+			strcpy(buf+len,symbol[i]);
+			len += strlen(symbol[i]);
 		}
 	}
-	format_append(buf,"(%d)",level);
+	snprintf(buf+len,size-len,"(%d)",level);
 	return buf;
 }
 
@@ -153,6 +155,8 @@ qq_account* qq_account_new(PurpleAccount* account)
 	lwqq_hash_add_entry(ac->qq, "hash_db",    (LwqqHashFunc)hash_with_db_url,      ac);
 #endif
 
+	ac->translator = qq_translator_ref();
+
 	ac->font.family = s_strdup("宋体");
 	ac->font.size = 12;
 	ac->font.style = 0;
@@ -161,8 +165,8 @@ qq_account* qq_account_new(PurpleAccount* account)
 #if QQ_USE_FAST_INDEX
 	ac->qq->find_buddy_by_uin = find_buddy_by_uin;
 	ac->qq->find_buddy_by_qqnumber = find_buddy_by_qqnumber;
-	ac->fast_index.uin_index = g_hash_table_new_full(g_str_hash,g_str_equal,g_free,g_free);
-	ac->fast_index.qqnum_index = g_hash_table_new_full(g_str_hash,g_str_equal,g_free,NULL);
+	num_index_init(&ac->fast_index.uin_index,0);
+	num_index_init(&ac->fast_index.qqnum_index,0);
 #endif
 	ac->qq->dispatch = qq_dispatch;
 	return ac;
@@ -179,9 +183,11 @@ void qq_account_free(qq_account* ac)
 	//g_ptr_array_free(ac->opend_chat,1);
 	s_free(ac->recent_group_name);
 	s_free(ac->font.family);
+	translate_font_cache_free(ac);
+	qq_translator_unref(ac->translator);
 #if QQ_USE_FAST_INDEX
-	g_hash_table_destroy(ac->fast_index.qqnum_index);
-	g_hash_table_destroy(ac->fast_index.uin_index);
+	num_index_free(&ac->fast_index.qqnum_index);
+	num_index_free(&ac->fast_index.uin_index);
 #endif
 	lwqq_http_cleanup(ac->qq, LWQQ_CLEANUP_IGNORE);
 	lwqq_client_free(ac->qq);
@@ -192,40 +198,63 @@ void qq_account_insert_index_node(qq_account* ac,const LwqqBuddy* b,const LwqqGr
 {
 #if QQ_USE_FAST_INDEX
 	if(!ac || (!b && !g)) return;
-	index_node* node = s_malloc0(sizeof(*node));
-	int type = b?NODE_IS_BUDDY:NODE_IS_GROUP;
-	node->type = type;
-	if(type == NODE_IS_BUDDY){
-		node->node = b;
-		const LwqqBuddy* buddy = b;
-		g_hash_table_insert(ac->fast_index.uin_index,s_strdup(buddy->uin),node);
-		if(buddy->qqnumber)
-			g_hash_table_insert(ac->fast_index.qqnum_index,s_strdup(buddy->qqnumber),node);
+	if(b){
+		num_index_insert(&ac->fast_index.uin_index,b->uin,NODE_IS_BUDDY,b);
+		if(b->qqnumber)
+			num_index_insert(&ac->fast_index.qqnum_index,b->qqnumber,NODE_IS_BUDDY,b);
 	}else{
-		node->node = g;
-		const LwqqGroup* group = g;
-		g_hash_table_insert(ac->fast_index.uin_index,s_strdup(group->gid),node);
-		if(group->account)
-			g_hash_table_insert(ac->fast_index.qqnum_index,s_strdup(group->account),node);
+		num_index_insert(&ac->fast_index.uin_index,g->gid,NODE_IS_GROUP,g);
+		if(g->account)
+			num_index_insert(&ac->fast_index.qqnum_index,g->account,NODE_IS_GROUP,g);
 	}
 #endif
 }
 void qq_account_remove_index_node(qq_account* ac,const LwqqBuddy* b,const LwqqGroup* g)
 {
 #if QQ_USE_FAST_INDEX
-	if(!ac || !(b && !g)) return;
+	if(!ac || (!b && !g)) return;
 	int type = b?NODE_IS_BUDDY:NODE_IS_GROUP;
 	if(type == NODE_IS_BUDDY){
 		const LwqqBuddy* buddy = b;
-		if(buddy->qqnumber)g_hash_table_remove(ac->fast_index.qqnum_index,buddy->qqnumber);
-		g_hash_table_remove(ac->fast_index.uin_index,buddy->uin);
+		if(buddy->qqnumber) num_index_remove(&ac->fast_index.qqnum_index,buddy->qqnumber);
+		num_index_remove(&ac->fast_index.uin_index,buddy->uin);
 	}else{
 		const LwqqGroup* group = g;
-		if(group->account) g_hash_table_remove(ac->fast_index.qqnum_index,group->account);
-		g_hash_table_remove(ac->fast_index.uin_index,group->gid);
+		if(group->account) num_index_remove(&ac->fast_index.qqnum_index,group->account);
+		num_index_remove(&ac->fast_index.uin_index,group->gid);
 	}
 #endif
 }
+void qq_account_rebuild_index(qq_account* ac)
+{
+#if QQ_USE_FAST_INDEX
+	LwqqClient* lc = ac->qq;
+	LwqqBuddy* buddy;
+	LwqqGroup* group;
+	size_t n = 0;
+	LIST_FOREACH(buddy,&lc->friends,entries) n++;
+	LIST_FOREACH(group,&lc->groups,entries) n++;
+	LIST_FOREACH(group,&lc->discus,entries) n++;
+	//size it once, instead of growing it through the whole list
+	num_index_free(&ac->fast_index.uin_index);
+	num_index_free(&ac->fast_index.qqnum_index);
+	num_index_init(&ac->fast_index.uin_index,n);
+	num_index_init(&ac->fast_index.qqnum_index,n);
+	LIST_FOREACH(buddy,&lc->friends,entries)
+		qq_account_insert_index_node(ac, buddy, NULL);
+	LIST_FOREACH(group,&lc->groups,entries)
+		qq_account_insert_index_node(ac, NULL, group);
+	LIST_FOREACH(group,&lc->discus,entries)
+		qq_account_insert_index_node(ac, NULL, group);
+#endif
+}
+void qq_account_linear_lookup(qq_account* ac,const char* what,const char* id)
+{
+#if QQ_USE_FAST_INDEX
+	gint n = g_atomic_int_add(&ac->fast_index.linear_lookup,1)+1;
+	lwqq_log(LOG_DEBUG,"linear lookup of %s %s, %d so far\n",what,id?id:"(null)",n);
+#endif
+}
 
 static PurpleConversation* find_conversation(LwqqMsgType msg_type,const char* serv_id,qq_account* ac, const char** local_id_out)
 {
@@ -280,7 +309,14 @@ LwqqBuddy* find_buddy_by_qqnumber(LwqqClient* lc,const char* qqnum)
 {
 	qq_account* ac = lwqq_client_userdata(lc);
 #if QQ_USE_FAST_INDEX
-	index_node* node = g_hash_table_lookup(ac->fast_index.qqnum_index,qqnum);
+	uint64_t key = num_index_key(qqnum);
+	const NumIndexSlot* node;
+	//ids which aren't decimal are never indexed
+	if(key == 0){
+		qq_account_linear_lookup(ac,"buddy qqnumber",qqnum);
+		return lwqq_buddy_find_buddy_by_qqnumber(lc, qqnum);
+	}
+	node = num_index_find_key(&ac->fast_index.qqnum_index,key);
 	if(node == NULL) return NULL;
 	if(node->type != NODE_IS_BUDDY) return NULL;
 	return (LwqqBuddy*)node->node;
@@ -292,7 +328,14 @@ LwqqGroup* find_group_by_qqnumber(LwqqClient* lc,const char* qqnum)
 {
 	qq_account* ac = lwqq_client_userdata(lc);
 #if QQ_USE_FAST_INDEX
-	index_node* node = g_hash_table_lookup(ac->fast_index.qqnum_index,qqnum);
+	uint64_t key = num_index_key(qqnum);
+	const NumIndexSlot* node;
+	//ids which aren't decimal are never indexed
+	if(key == 0){
+		qq_account_linear_lookup(ac,"group qqnumber",qqnum);
+		return lwqq_group_find_group_by_qqnumber(lc, qqnum);
+	}
+	node = num_index_find_key(&ac->fast_index.qqnum_index,key);
 	if(node == NULL) return NULL;
 	if(node->type != NODE_IS_GROUP) return NULL;
 	return (LwqqGroup*)node->node;
@@ -305,7 +348,14 @@ LwqqBuddy* find_buddy_by_uin(LwqqClient* lc,const char* uin)
 {
 #if QQ_USE_FAST_INDEX
 	qq_account* ac = lwqq_client_userdata(lc);
-	index_node* node = g_hash_table_lookup(ac->fast_index.uin_index,uin);
+	uint64_t key = num_index_key(uin);
+	const NumIndexSlot* node;
+	//ids which aren't decimal are never indexed
+	if(key == 0){
+		qq_account_linear_lookup(ac,"buddy uin",uin);
+		return lwqq_buddy_find_buddy_by_uin(lc, uin);
+	}
+	node = num_index_find_key(&ac->fast_index.uin_index,key);
 	if(node == NULL) return NULL;
 	if(node->type != NODE_IS_BUDDY) return NULL;
 	return (LwqqBuddy*)node->node;
@@ -317,7 +367,14 @@ LwqqGroup* find_group_by_gid(LwqqClient* lc,const char* gid)
 {
 #if QQ_USE_FAST_INDEX
 	qq_account* ac = lwqq_client_userdata(lc);
-	index_node* node = g_hash_table_lookup(ac->fast_index.uin_index,gid);
+	uint64_t key = num_index_key(gid);
+	const NumIndexSlot* node;
+	//ids which aren't decimal are never indexed
+	if(key == 0){
+		qq_account_linear_lookup(ac,"group gid",gid);
+		return lwqq_group_find_group_by_gid(lc, gid);
+	}
+	node = num_index_find_key(&ac->fast_index.uin_index,key);
 	if(node == NULL) return NULL;
 	if(node->type != NODE_IS_GROUP) return NULL;
 	return (LwqqGroup*)node->node;
@@ -7,6 +7,7 @@
 #include "lwdb.h"
 #include "config.h"
 #include "lwjs.h"
+#include "numindex.h"
 
 #ifdef ENABLE_NLS
 #include <glib/gi18n.h>
@@ -41,10 +42,8 @@
 #define QQ_ROOM_TYPE_QUN "qun"
 #define QQ_ROOM_TYPE_DISCU "discu"
 
-typedef struct {
-	enum {NODE_IS_BUDDY,NODE_IS_GROUP} type;
-	const void* node;
-}index_node;
+enum {NODE_IS_BUDDY,NODE_IS_GROUP};
+typedef struct qq_translator qq_translator;
 typedef struct qq_account {
 	LwqqClient* qq;
 	PurpleAccount* account;
@@ -58,7 +57,7 @@ typedef struct qq_account {
 	}state;
 	int msg_poll_handle;
 	int relink_timer;
-	GList* rewrite_pic_list;
+	GList* rewrite_msg_list;
 	char* recent_group_name;
 	PurpleLog* sys_log;
 	struct {
@@ -66,6 +65,12 @@ typedef struct qq_account {
 		int size;
 		LwqqFontStyle style;
 	}font;
+	struct qq_font_cache* font_cache;///< rendered font header of received msg
+	qq_translator* translator;///< shared smiley data, see translate.c
+	GThreadPool* translate_pool;///< optional, translates received msg, see webqq.c
+	GQueue* recv_jobs;///< received msg in arriving order, waiting to be shown
+	GAsyncQueue* recv_done;///< jobs finished by translate_pool
+	guint recv_idle;///< flush posted by a worker, guarded by recv_done
 	enum {
 		QQ_USE_QQNUM = 1<<0,
 		IGNORE_FONT_FACE = 1<<1,
@@ -79,8 +84,9 @@ typedef struct qq_account {
 	}flag;
 #if QQ_USE_FAST_INDEX
 	struct{
-		GHashTable* qqnum_index;
-		GHashTable* uin_index;          ///< key:char*,value:struct index_node
+		NumIndex qqnum_index;
+		NumIndex uin_index;          ///< key:uin or gid,value:buddy or group
+		gint linear_lookup;          ///< lookups which still walked lwqq's list
 	}fast_index;
 #endif
 	lwqq_js_t* js;
@@ -106,6 +112,10 @@ void qq_account_free(qq_account* ac);
 
 void qq_account_insert_index_node(qq_account* ac,const LwqqBuddy* b,const LwqqGroup* g);
 void qq_account_remove_index_node(qq_account* ac,const LwqqBuddy* b,const LwqqGroup* g);
+/** refill fast index from all buddies, groups and discus of ac->qq */
+void qq_account_rebuild_index(qq_account* ac);
+/** count and log a lookup which walks lwqq's list instead of fast index */
+void qq_account_linear_lookup(qq_account* ac,const char* what,const char* id);
 
 void qq_sys_msg_write(qq_account* ac,LwqqMsgType m_t,const char* serv_id,const char* msg,PurpleMessageFlags type,time_t t);
 void qq_system_log(qq_account* ac,const char* log);
@@ -128,7 +138,7 @@ const char* qq_constel_to_str(LwqqConstel constel);
 const char* qq_blood_to_str(LwqqBloodType bt);
 const char* qq_shengxiao_to_str(LwqqShengxiao shengxiao);
 const char* qq_client_to_str(LwqqClientType client);
-const char* qq_level_to_str(int level);
+const char* qq_level_to_str(int level,char* buf,size_t size);
 const char* qq_status_to_str(LwqqStatus status);
 LwqqStatus qq_status_from_str(const char* str);
 
@@ -0,0 +1,132 @@
+/**
+ * res_pack: pack resource files into one indexed bundle at build time.
+ *
+ * usage: res_pack <res dir> <file.list> <out.pack>
+ *
+ * file.list holds one path per line, relative to res dir, like
+ * baozou/01.gif. the bundle layout, all integers are little endian u32:
+ *  - header : "LWQQPACK" version count
+ *  - index  : count * {name_off name_len data_off data_len}, sorted by name
+ *  - names and data, data is 8 bytes aligned
+ * offsets are from the start of file. see respack.c for the reader.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "respack.h"
+
+#define MAX_LINE 1024
+
+struct file {
+	char* name;
+	char* data;
+	uint32_t size;
+	uint32_t name_off,data_off;
+};
+static struct file* files;
+static size_t nfiles,files_cap;
+
+static void* xrealloc(void* p,size_t sz)
+{
+	p = realloc(p,sz);
+	if(p==NULL){fprintf(stderr,"res_pack: out of memory\n");exit(1);}
+	return p;
+}
+static int cmp_file(const void* a,const void* b)
+{
+	return strcmp(((const struct file*)a)->name,((const struct file*)b)->name);
+}
+static int read_file(const char* path,struct file* f)
+{
+	FILE* in = fopen(path,"rb");
+	long size;
+	if(in==NULL){perror(path);return 1;}
+	if(fseek(in,0,SEEK_END)!=0 || (size = ftell(in))<0 || fseek(in,0,SEEK_SET)!=0){
+		perror(path);
+		fclose(in);
+		return 1;
+	}
+	f->data = xrealloc(NULL,size?size:1);
+	if(fread(f->data,1,size,in)!=(size_t)size){
+		perror(path);
+		fclose(in);
+		return 1;
+	}
+	f->size = size;
+	fclose(in);
+	return 0;
+}
+static void put_u32(FILE* o,uint32_t v)
+{
+	unsigned char b[4] = {v&0xff,v>>8&0xff,v>>16&0xff,v>>24&0xff};
+	fwrite(b,1,4,o);
+}
+
+int main(int argc,char** argv)
+{
+	char line[MAX_LINE],path[MAX_LINE*2];
+	FILE *list,*o;
+	size_t i;
+	uint32_t off;
+	if(argc!=4){
+		fprintf(stderr,"usage: %s <res dir> <file.list> <out.pack>\n",argv[0]);
+		return 1;
+	}
+	list = fopen(argv[2],"r");
+	if(list==NULL){perror(argv[2]);return 1;}
+	while(fgets(line,sizeof(line),list)){
+		size_t len = strcspn(line,"\r\n");
+		line[len] = '\0';
+		if(len==0) continue;
+		if(nfiles==files_cap){
+			files_cap = files_cap?files_cap*2:1024;
+			files = xrealloc(files,sizeof(*files)*files_cap);
+		}
+		memset(&files[nfiles],0,sizeof(*files));
+		files[nfiles].name = strcpy(xrealloc(NULL,len+1),line);
+		snprintf(path,sizeof(path),"%s/%s",argv[1],line);
+		if(read_file(path,&files[nfiles])) return 1;
+		nfiles++;
+	}
+	fclose(list);
+	qsort(files,nfiles,sizeof(*files),cmp_file);
+	for(i=1;i<nfiles;i++)
+		if(strcmp(files[i-1].name,files[i].name)==0){
+			fprintf(stderr,"res_pack: duplicated %s\n",files[i].name);
+			return 1;
+		}
+
+	off = RES_PACK_HEADER_SIZE+nfiles*RES_PACK_ENTRY_SIZE;
+	for(i=0;i<nfiles;i++){
+		files[i].name_off = off;
+		off += strlen(files[i].name);
+	}
+	for(i=0;i<nfiles;i++){
+		off = (off+7)&~7u;
+		files[i].data_off = off;
+		off += files[i].size;
+	}
+
+	o = fopen(argv[3],"wb");
+	if(o==NULL){perror(argv[3]);return 1;}
+	fwrite(RES_PACK_MAGIC,1,8,o);
+	put_u32(o,RES_PACK_VERSION);
+	put_u32(o,nfiles);
+	for(i=0;i<nfiles;i++){
+		put_u32(o,files[i].name_off);
+		put_u32(o,strlen(files[i].name));
+		put_u32(o,files[i].data_off);
+		put_u32(o,files[i].size);
+	}
+	for(i=0;i<nfiles;i++)
+		fwrite(files[i].name,1,strlen(files[i].name),o);
+	for(i=0;i<nfiles;i++){
+		static const char pad[8] = {0};
+		long pos = ftell(o);
+		fwrite(pad,1,files[i].data_off-pos,o);
+		fwrite(files[i].data,1,files[i].size,o);
+	}
+	if(fclose(o)!=0){perror(argv[3]);return 1;}
+	return 0;
+}
@@ -0,0 +1,77 @@
+#include <string.h>
+#include <stdint.h>
+#include <glib.h>
+#include "respack.h"
+
+struct ResPack {
+	GMappedFile* file;
+	const unsigned char* base;
+	size_t length;
+	uint32_t count;
+};
+
+static uint32_t get_u32(const unsigned char* p)
+{
+	return p[0]|p[1]<<8|p[2]<<16|(uint32_t)p[3]<<24;
+}
+static const unsigned char* entry(const ResPack* pack,uint32_t i)
+{
+	return pack->base+RES_PACK_HEADER_SIZE+(size_t)i*RES_PACK_ENTRY_SIZE;
+}
+
+ResPack* res_pack_open(const char* path)
+{
+	GMappedFile* file = g_mapped_file_new(path,FALSE,NULL);
+	ResPack* pack;
+	uint32_t i;
+	if(file==NULL) return NULL;
+	pack = g_malloc0(sizeof(*pack));
+	pack->file = file;
+	pack->base = (const unsigned char*)g_mapped_file_get_contents(file);
+	pack->length = g_mapped_file_get_length(file);
+	if(pack->length<RES_PACK_HEADER_SIZE
+			|| memcmp(pack->base,RES_PACK_MAGIC,8)!=0
+			|| get_u32(pack->base+8)!=RES_PACK_VERSION)
+		goto broken;
+	pack->count = get_u32(pack->base+12);
+	if(pack->count>(pack->length-RES_PACK_HEADER_SIZE)/RES_PACK_ENTRY_SIZE)
+		goto broken;
+	//check once, so lookup needs no bound check
+	for(i=0;i<pack->count;i++){
+		const unsigned char* e = entry(pack,i);
+		if(get_u32(e)>pack->length || get_u32(e+4)>pack->length-get_u32(e)
+				|| get_u32(e+8)>pack->length || get_u32(e+12)>pack->length-get_u32(e+8))
+			goto broken;
+	}
+	return pack;
+broken:
+	res_pack_close(pack);
+	return NULL;
+}
+
+void res_pack_close(ResPack* pack)
+{
+	if(pack==NULL) return;
+	g_mapped_file_unref(pack->file);
+	g_free(pack);
+}
+
+const char* res_pack_find(const ResPack* pack,const char* name,size_t* size)
+{
+	size_t len = strlen(name);
+	uint32_t lo = 0,hi = pack?pack->count:0;
+	while(lo<hi){
+		uint32_t mid = lo+(hi-lo)/2;
+		const unsigned char* e = entry(pack,mid);
+		uint32_t nlen = get_u32(e+4);
+		int c = memcmp(pack->base+get_u32(e),name,nlen<len?nlen:len);
+		if(c==0) c = nlen<len?-1:nlen>len;
+		if(c==0){
+			*size = get_u32(e+12);
+			return (const char*)pack->base+get_u32(e+8);
+		}
+		if(c<0) lo = mid+1;
+		else hi = mid;
+	}
+	return NULL;
+}
@@ -0,0 +1,26 @@
+#ifndef RESPACK_H_H
+#define RESPACK_H_H
+#include <stddef.h>
+
+/**
+ * read only resource bundle made by res_pack at build time.
+ * it is mapped once, and file data is served straight from the mapping.
+ */
+#define RES_PACK_MAGIC "LWQQPACK"
+#define RES_PACK_VERSION 1
+#define RES_PACK_HEADER_SIZE 16
+#define RES_PACK_ENTRY_SIZE 16
+
+typedef struct ResPack ResPack;
+
+/** map bundle of path, return NULL when it is missing or broken */
+ResPack* res_pack_open(const char* path);
+void res_pack_close(ResPack* pack);
+/**
+ * find file by its name relative to res dir, like "baozou/01.gif".
+ * return data inside the mapping and set *size, or NULL.
+ * data lives until res_pack_close.
+ */
+const char* res_pack_find(const ResPack* pack,const char* name,size_t* size);
+
+#endif
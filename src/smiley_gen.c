@@ -0,0 +1,281 @@
+/**
+ * smiley_gen: compile res/smiley.txt into smiley_table.h at build time.
+ *
+ * usage: smiley_gen <smiley.txt> <smiley_table.h>
+ *
+ * the input is parsed exactly like translate.c used to parse it at runtime:
+ * a number starts a face, following words are its shortcuts; a gif or png
+ * word starts a picture smiley, following words are its shortcuts.
+ * emitted:
+ *  - smiley_face_shortcut[] : dense face id -> first shortcut
+ *  - smiley_hash_disp[]/smiley_hash_slot[] : a CHD perfect hash from
+ *    shortcut to face id, last definition wins
+ *  - smiley_pic[] : picture smileys, file relative to the smiley.txt dir
+ *  - smiley_literal[] : non :xxx: shortcuts in file order, they are matched
+ *    literally in text, while :xxx: ones are looked up through the hash
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "smiley_hash.h"
+
+#define MAX_TOKEN 256
+
+struct shortcut {
+	char* str;
+	long face;
+	uint32_t slot;
+};
+struct pic {
+	char* shortcut;
+	char* file;
+};
+
+static struct shortcut* keys;
+static size_t nkeys,keys_cap;
+static char** faces;
+static long nfaces;
+static struct pic* pics;
+static size_t npics,pics_cap;
+static char** literals;
+static size_t nliterals,literals_cap;
+
+static void* xrealloc(void* p,size_t sz)
+{
+	p = realloc(p,sz);
+	if(p==NULL){fprintf(stderr,"smiley_gen: out of memory\n");exit(1);}
+	return p;
+}
+static char* xstrdup(const char* s)
+{
+	size_t l = strlen(s)+1;
+	return memcpy(xrealloc(NULL,l),s,l);
+}
+static void add_face(const char* s,long face)
+{
+	size_t i;
+	if(face>=nfaces){
+		faces = xrealloc(faces,sizeof(*faces)*(face+1));
+		memset(faces+nfaces,0,sizeof(*faces)*(face+1-nfaces));
+		nfaces = face+1;
+	}
+	//id->shortcut only once
+	if(faces[face]==NULL) faces[face] = xstrdup(s);
+	//shortcut->id, the last one wins
+	for(i=0;i<nkeys;i++)
+		if(strcmp(keys[i].str,s)==0){keys[i].face = face;return;}
+	if(nkeys==keys_cap){
+		keys_cap = keys_cap?keys_cap*2:256;
+		keys = xrealloc(keys,sizeof(*keys)*keys_cap);
+	}
+	keys[nkeys].str = xstrdup(s);
+	keys[nkeys].face = face;
+	nkeys++;
+}
+static void add_pic(const char* s,const char* file)
+{
+	if(npics==pics_cap){
+		pics_cap = pics_cap?pics_cap*2:256;
+		pics = xrealloc(pics,sizeof(*pics)*pics_cap);
+	}
+	pics[npics].shortcut = xstrdup(s);
+	pics[npics].file = xstrdup(file);
+	npics++;
+}
+static void add_literal(const char* s)
+{
+	size_t i;
+	for(i=0;i<nliterals;i++)
+		if(strcmp(literals[i],s)==0) return;
+	if(nliterals==literals_cap){
+		literals_cap = literals_cap?literals_cap*2:64;
+		literals = xrealloc(literals,sizeof(*literals)*literals_cap);
+	}
+	literals[nliterals++] = xstrdup(s);
+}
+static int parse(FILE* f)
+{
+	enum {LAST_IS_NONE, LAST_IS_NUMBER, LAST_IS_PIC} last_mode = LAST_IS_NONE;
+	char smiley[MAX_TOKEN];
+	char last_file[MAX_TOKEN] = "";
+	long num = 0;
+	char* end;
+	while(fscanf(f,"%255s",smiley)==1){
+		size_t len = strlen(smiley);
+		long n = strtol(smiley,&end,10);
+		if(*end=='\0'){
+			if(n<0){fprintf(stderr,"smiley_gen: bad face id %s\n",smiley);return 1;}
+			num = n;
+			last_mode = LAST_IS_NUMBER;
+			continue;
+		}
+		if(len>3 && (strcmp(smiley+len-3,"gif")==0 || strcmp(smiley+len-3,"png")==0)){
+			strcpy(last_file,smiley);
+			last_mode = LAST_IS_PIC;
+			continue;
+		}
+		if(last_mode == LAST_IS_PIC)
+			add_pic(smiley,last_file);
+		else if(last_mode == LAST_IS_NUMBER){
+			add_face(smiley,num);
+			if(smiley[0]==':'&&smiley[len-1]==':') continue;
+			add_literal(smiley);
+		}
+	}
+	return 0;
+}
+
+static size_t* bucket_of;
+static size_t nbuckets;
+static int cmp_bucket_size(const void* a,const void* b)
+{
+	const size_t* x = a,*y = b;
+	return (int)y[1]-(int)x[1];
+}
+//CHD: hash keys into buckets, place the biggest bucket first and search
+//a displacement seed for each bucket so all of its keys land on free slots.
+static int build_perfect_hash(uint16_t** disp_out,uint32_t* nslots_out)
+{
+	uint32_t nslots = nkeys+nkeys/4+1;
+	size_t* order;
+	char* used;
+	uint16_t* disp;
+	size_t b,i,j;
+	nbuckets = nkeys/4+1;
+	order = xrealloc(NULL,sizeof(size_t)*2*nbuckets);
+	bucket_of = xrealloc(NULL,sizeof(size_t)*nkeys);
+	for(b=0;b<nbuckets;b++){order[2*b] = b;order[2*b+1] = 0;}
+	for(i=0;i<nkeys;i++){
+		bucket_of[i] = smiley_hash_str(keys[i].str,strlen(keys[i].str),0)%nbuckets;
+		order[2*bucket_of[i]+1]++;
+	}
+	qsort(order,nbuckets,sizeof(size_t)*2,cmp_bucket_size);
+	used = calloc(nslots,1);
+	disp = calloc(nbuckets,sizeof(*disp));
+	if(!used||!disp){fprintf(stderr,"smiley_gen: out of memory\n");return 1;}
+	for(b=0;b<nbuckets && order[2*b+1];b++){
+		size_t bucket = order[2*b];
+		uint32_t d;
+		for(d=1;d<0xffff;d++){
+			int ok = 1;
+			for(i=0;i<nkeys&&ok;i++){
+				if(bucket_of[i]!=bucket) continue;
+				keys[i].slot = smiley_hash_str(keys[i].str,strlen(keys[i].str),d)%nslots;
+				if(used[keys[i].slot]) ok = 0;
+				for(j=0;j<i&&ok;j++)
+					if(bucket_of[j]==bucket && keys[j].slot==keys[i].slot) ok = 0;
+			}
+			if(ok) break;
+		}
+		if(d==0xffff){fprintf(stderr,"smiley_gen: no perfect hash found\n");return 1;}
+		disp[bucket] = d;
+		for(i=0;i<nkeys;i++)
+			if(bucket_of[i]==bucket) used[keys[i].slot] = 1;
+	}
+	free(used);
+	free(order);
+	*disp_out = disp;
+	*nslots_out = nslots;
+	return 0;
+}
+
+static void put_str(FILE* o,const char* s)
+{
+	if(s==NULL){fputs("NULL",o);return;}
+	fputc('"',o);
+	for(;*s;s++){
+		unsigned char c = *s;
+		if(c=='"'||c=='\\') fprintf(o,"\\%c",c);
+		else if(c<0x20||c>=0x7f) fprintf(o,"\\%03o",c);
+		else fputc(c,o);
+	}
+	fputc('"',o);
+}
+
+int main(int argc,char** argv)
+{
+	FILE *f,*o;
+	uint16_t* disp;
+	uint32_t nslots,s;
+	size_t i;
+	long id;
+	if(argc!=3){
+		fprintf(stderr,"usage: %s <smiley.txt> <smiley_table.h>\n",argv[0]);
+		return 1;
+	}
+	f = fopen(argv[1],"r");
+	if(f==NULL){perror(argv[1]);return 1;}
+	if(parse(f)) return 1;
+	fclose(f);
+	if(build_perfect_hash(&disp,&nslots)) return 1;
+
+	o = fopen(argv[2],"w");
+	if(o==NULL){perror(argv[2]);return 1;}
+	fprintf(o,"//generated by smiley_gen from smiley.txt, do not edit\n");
+	fprintf(o,"#ifndef SMILEY_TABLE_H_H\n#define SMILEY_TABLE_H_H\n");
+	fprintf(o,"#include <string.h>\n#include \"smiley_hash.h\"\n\n");
+
+	fprintf(o,"#define SMILEY_FACE_MAX %ld\n",nfaces);
+	fprintf(o,"static const char* const smiley_face_shortcut[%ld] = {\n",nfaces?nfaces:1);
+	for(id=0;id<nfaces;id++){
+		fputc('\t',o);
+		put_str(o,faces[id]);
+		fprintf(o,",\n");
+	}
+	if(nfaces==0) fprintf(o,"\tNULL\n");
+	fprintf(o,"};\n\n");
+
+	fprintf(o,"#define SMILEY_HASH_BUCKETS %zu\n",nbuckets);
+	fprintf(o,"#define SMILEY_HASH_SLOTS %u\n",nslots);
+	fprintf(o,"static const uint16_t smiley_hash_disp[%zu] = {",nbuckets);
+	for(i=0;i<nbuckets;i++)
+		fprintf(o,"%s%u,",i%16?"":"\n\t",disp[i]);
+	fprintf(o,"\n};\n");
+	fprintf(o,"struct smiley_slot {const char* shortcut; int face;};\n");
+	fprintf(o,"static const struct smiley_slot smiley_hash_slot[%u] = {\n",nslots);
+	for(s=0;s<nslots;s++){
+		for(i=0;i<nkeys;i++) if(keys[i].slot==s) break;
+		fputs("\t{",o);
+		if(i<nkeys){
+			put_str(o,keys[i].str);
+			fprintf(o,", %ld},\n",keys[i].face);
+		}else
+			fputs("NULL, -1},\n",o);
+	}
+	fprintf(o,"};\n\n");
+
+	fprintf(o,"struct smiley_pic {const char* shortcut; const char* file;};\n");
+	fprintf(o,"#define SMILEY_PIC_NUM %zu\n",npics);
+	fprintf(o,"static const struct smiley_pic smiley_pic[%zu] = {\n",npics?npics:1);
+	for(i=0;i<npics;i++){
+		fputs("\t{",o);
+		put_str(o,pics[i].shortcut);
+		fputs(", ",o);
+		put_str(o,pics[i].file);
+		fputs("},\n",o);
+	}
+	if(npics==0) fputs("\t{NULL, NULL}\n",o);
+	fprintf(o,"};\n\n");
+
+	fprintf(o,"#define SMILEY_LITERAL_NUM %zu\n",nliterals);
+	fprintf(o,"static const char* const smiley_literal[%zu] = {\n",nliterals?nliterals:1);
+	for(i=0;i<nliterals;i++){
+		fputc('\t',o);
+		put_str(o,literals[i]);
+		fprintf(o,",\n");
+	}
+	if(nliterals==0) fprintf(o,"\tNULL\n");
+	fprintf(o,"};\n\n");
+
+	fprintf(o,"//return face id of shortcut s[0,len) or -1\n");
+	fprintf(o,"static inline int smiley_builtin_lookup(const char* s,size_t len)\n{\n");
+	fprintf(o,"\tuint32_t d = smiley_hash_disp[smiley_hash_str(s,len,0)%%SMILEY_HASH_BUCKETS];\n");
+	fprintf(o,"\tconst struct smiley_slot* slot;\n");
+	fprintf(o,"\tif(d==0) return -1;\n");
+	fprintf(o,"\tslot = &smiley_hash_slot[smiley_hash_str(s,len,d)%%SMILEY_HASH_SLOTS];\n");
+	fprintf(o,"\tif(slot->shortcut==NULL||strncmp(slot->shortcut,s,len)!=0||slot->shortcut[len]!='\\0') return -1;\n");
+	fprintf(o,"\treturn slot->face;\n}\n\n");
+	fprintf(o,"#endif\n");
+	if(fclose(o)!=0){perror(argv[2]);return 1;}
+	return 0;
+}
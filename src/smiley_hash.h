@@ -0,0 +1,24 @@
+#ifndef SMILEY_HASH_H_H
+#define SMILEY_HASH_H_H
+#include <stddef.h>
+#include <stdint.h>
+
+//shared by smiley_gen and translate.c, the compiled table is only valid
+//as long as both sides hash shortcuts the same way.
+static inline uint32_t smiley_hash_str(const char* s,size_t len,uint32_t seed)
+{
+	uint32_t h = 2166136261u ^ (seed*0x9e3779b9u);
+	size_t i;
+	for(i=0;i<len;i++){
+		h ^= (unsigned char)s[i];
+		h *= 16777619u;
+	}
+	h ^= h>>15;
+	h *= 0x2c1b3c6du;
+	h ^= h>>12;
+	h *= 0x297a2d39u;
+	h ^= h>>15;
+	return h;
+}
+
+#endif
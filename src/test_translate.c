@@ -0,0 +1,94 @@
+/**
+ * test_translate: checks of translate.c, run by ctest when built with
+ * -DTESTS=On. translate.c is included to reach its static helpers and
+ * libpurple is replaced by bench_purple.c.
+ */
+#include "translate.c"
+
+static int failed;
+#define CHECK(cond) \
+	do{ if(!(cond)){ fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); failed++; } }while(0)
+
+//file of the only emoji found in s, "" when there is none
+static const char* only_emoji(const char* s)
+{
+	qq_msg_ir* ir = s_malloc0(sizeof(*ir));
+	const char* file = "";
+	size_t i;
+	int found = 0;
+	ir_push_utf8(ir, s, strlen(s), 1, 1);
+	for(i=0;i<ir->nnode;i++){
+		if(ir->node[i].type != IR_EMOJI) continue;
+		file = emoji_table[ir->node[i].d.emoji.idx].file;
+		found++;
+	}
+	translate_ir_free(ir);
+	return found>1?"more than one":file;
+}
+
+static void test_emoji_presentation()
+{
+	//text presentation by default, an emoji only with U+FE0F
+	CHECK(strcmp(only_emoji("(c) \xC2\xA9"), "") == 0);
+	CHECK(strcmp(only_emoji("\xC2\xAE \xE2\x84\xA2"), "") == 0);
+	CHECK(strcmp(only_emoji("\xC2\xA9\xEF\xB8\x8F"), "00a9.png") == 0);
+	CHECK(strcmp(only_emoji("\xF0\x9F\x85\xB0"), "") == 0);
+	CHECK(strcmp(only_emoji("\xF0\x9F\x85\xB0\xEF\xB8\x8F"), "1f170.png") == 0);
+	//keycap
+	CHECK(strcmp(only_emoji("1\xE2\x83\xA3"), "") == 0);
+	CHECK(strcmp(only_emoji("1\xEF\xB8\x8F\xE2\x83\xA3"), "0031-20e3.png") == 0);
+	//emoji presentation by default
+	CHECK(strcmp(only_emoji("\xE2\x8C\x9A"), "231a.png") == 0);
+	CHECK(strcmp(only_emoji("\xF0\x9F\x98\x80"), "1f600.png") == 0);
+	CHECK(strcmp(only_emoji("\xF0\x9F\x87\xA8\xF0\x9F\x87\xB3"), "1f1e8-1f1f3.png") == 0);
+}
+
+static void test_copyright_stays_text(qq_account* ac)
+{
+	LwqqMsg* msg = lwqq_msg_new(LWQQ_MS_BUDDY_MSG);
+	struct ds s;
+	translate_message_to_struct(ac->translator, "10000", "(c) \xC2\xA9", msg, 0);
+	s = translate_struct_to_message(ac, (LwqqMsgMessage*)msg, PURPLE_MESSAGE_RECV);
+	CHECK(ds_c_str(s) && strstr(ds_c_str(s), "(c) \xC2\xA9"));
+	CHECK(ds_c_str(s) && !strstr(ds_c_str(s), "<IMG"));
+	ds_free(s);
+	lwqq_msg_free(msg);
+}
+
+//every symbol at every offset around the 16, 32 and 64 byte blocks of
+//html_clean_span
+static void test_html_escape()
+{
+	static const char* const sym[] = {"<","&lt;", ">","&gt;", "&","&amp;",
+		"\"","&quot;", "'","&apos;", "=","=", "?","?", "%","%", "$","$"};
+	char in[160],want[200];
+	size_t pos,k;
+	for(k=0;k<sizeof(sym)/sizeof(sym[0]);k+=2){
+		for(pos=0;pos<130;pos++){
+			char* out;
+			memset(in, 'a', pos);
+			strcpy(in+pos, sym[k]);
+			strcat(in, "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbb");
+			memset(want, 'a', pos);
+			strcpy(want+pos, sym[k+1]);
+			strcat(want, "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbb");
+			out = translate_to_html_symbol(in);
+			CHECK(strcmp(out, want) == 0);
+			s_free(out);
+		}
+	}
+}
+
+int main()
+{
+	qq_account* ac = s_malloc0(sizeof(*ac));
+	ac->translator = qq_translator_ref();
+	test_emoji_presentation();
+	test_html_escape();
+	test_copyright_stays_text(ac);
+	translate_font_cache_free(ac);
+	qq_translator_unref(ac->translator);
+	s_free(ac);
+	if(failed) fprintf(stderr, "%d checks failed\n", failed);
+	return failed?1:0;
+}
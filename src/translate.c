@@ -1,14 +1,25 @@
 #include <imgstore.h>
 #include <string.h>
 #include <assert.h>
+#include <ctype.h>
 #include <smiley.h>
 #include <accountopt.h>
+#include <signals.h>
 #include "translate.h"
-#include "trex.h"
+#include "ac.h"
+#include "utf8.h"
+#include "respack.h"
 #include "qq_types.h"
+#include "smiley_table.h"
+#include "emoji_table.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define LOCAL_SMILEY_PATH(path) (snprintf(path,sizeof(path),"%s"LWQQ_PATH_SEP"smiley.txt",lwdb_get_config_dir()),path)
-#define GLOBAL_SMILEY_PATH(path) (snprintf(path,sizeof(path),"%s"LWQQ_PATH_SEP"smiley.txt",RES_DIR),path)
 
 static
 TABLE_BEGIN_LONG(to_html_symbol, const char*, const char, "")
@@ -19,66 +30,87 @@ TABLE_BEGIN_LONG(to_html_symbol, const char*, const char, "")
 	TR('\'', "&apos;")
 TABLE_END()
 
-#define key_eq(a,b) (a==b)
-#define val_eq(a,b) (strncmp(a,b,strlen(a))==0)
-PAIR_BEGIN_LONG(html_map, const char, const char*)
-	PAIR('\n', "<br>"  )
-	PAIR('&' , "&amp;" )
-	PAIR('"' , "&quot;")
-	PAIR('<' , "&lt;"  )
-	PAIR('>' , "&gt;"  )
-	PAIR('\'', "&apos;")
-PAIR_END(html_map, const char, const char*, 0, NULL)
-
-PAIR_BEGIN_LONG(style_map, int, const char*)
-	PAIR(LWQQ_FONT_BOLD     , "<b ")
-	PAIR(LWQQ_FONT_BOLD     , "<b>")
-	PAIR(LWQQ_FONT_ITALIC   , "<i ")
-	PAIR(LWQQ_FONT_ITALIC   , "<i>")
-	PAIR(LWQQ_FONT_UNDERLINE, "<u ")
-	PAIR(LWQQ_FONT_UNDERLINE, "<u>")
-PAIR_END(style_map, int, const char*, 0, NULL)
+static const struct {
+	const char* name;
+	size_t len;
+	char c;
+} html_entity[] = {
+	{"&amp;" , 5, '&' },
+	{"&quot;", 6, '"' },
+	{"&lt;"  , 4, '<' },
+	{"&gt;"  , 4, '>' },
+	{"&apos;", 6, '\''},
+};
 
-static GHashTable* smiley_hash;
-static TRex* _regex;
-static TRex* hs_regex;
+//picture smiley, only its shortcut is kept until a message uses it
+struct smiley_pic_entry {
+	char* shortcut;
+	char* file;///< relative to res dir, or full path of a local one
+	int local;
+};
+//smiley data shared by all accounts. it is immutable once built, so
+//several accounts or threads could translate with it at the same time.
+//res/smiley.txt is compiled into smiley_table.h, the hash tables only
+//hold the local overlay.
+struct qq_translator {
+	int ref;
+	GHashTable* smiley_hash;//shortcut -> face id+1
+	GHashTable* local_face;//face id+1 -> shortcut
+	AcAutomaton* smiley_ac;
+	ResPack* res;//packed resource files, NULL when not installed
+	GHashTable* res_override;//set of loose resource files in user config dir
+	struct smiley_pic_entry* pic;//index is its priority in pic_ac
+	int npic,pic_cap;
+	AcAutomaton* pic_ac;
+};
+static qq_translator* translator;
+//directories packed by res_pack, see CMakeLists.txt
+static const char* const res_pack_dirs[] = {"baozou", "emoji"};
 
-//we dont free this, let it leak a small memory.
-static char *smiley_tables[150]={0};
 #define HTML_SPEC_SYMBOL "<>&\"'"
-#define HTML_SPEC_SYMBOL_ESCAPE "&lt;|&gt;|&quot;|&apos;|&amp;"
-#define HTML_SYMBOL "<[^>]+>|"HTML_SPEC_SYMBOL_ESCAPE
-const char* REGEXP_HEAD = "<[^>]+>|:face\\d+:|:-face:";
-const char* REGEXP_TAIL = "|:[^ :]+:";
 //font size map space : pidgin:[1,7] to webqq[8:20]
 #define sizemap(num) (6+2*num)
 //font size map space : webqq[8:22] to pidgin [1:8]
 #define sizeunmap(px) ((px-6)/2)
-//this is used for build smiley regex expression
-static void build_smiley_exp_from_file(char* exp,const char* path)
+//this is used for load local smiley overlay
+static void add_smiley_pic(qq_translator* t,const char* shortcut,const char* file,int local)
+{
+	struct smiley_pic_entry* e;
+	//the first definition of a shortcut wins, as purple_smiley_new does
+	if(ac_add(t->pic_ac,shortcut,strlen(shortcut))!=t->npic) return;
+	if(t->npic==t->pic_cap){
+		t->pic_cap = t->pic_cap?t->pic_cap*2:256;
+		t->pic = s_realloc(t->pic,sizeof(*t->pic)*t->pic_cap);
+	}
+	e = &t->pic[t->npic++];
+	e->shortcut = s_strdup(shortcut);
+	e->file = s_strdup(file);
+	e->local = local;
+}
+static void load_smiley_from_file(qq_translator* t,const char* path)
 {
-	enum {LAST_IS_NUMBER, LAST_IS_PIC} last_mode;
+	enum {LAST_IS_NONE, LAST_IS_NUMBER, LAST_IS_PIC} last_mode = LAST_IS_NONE;
 	char smiley[256];
-	char last_file[256];
-	char file_dir[256];
-	long id,num;
-	char *beg,*end;
-	const char* spec_char = "?()[]*$\\|+.";
+	char last_file[1024];
+	char* file_dir;
+	long id = 0,num;
+	char *end;
+	size_t len;
 	FILE* f =fopen(path,"r");
 	if(f==NULL) return;
-	strcpy(file_dir, path);
-	*strrchr(file_dir, '/') = '\0'; //strip for the last dir
-	while(fscanf(f,"%s",smiley)!=EOF){
+	file_dir = g_path_get_dirname(path);
+	//longer words are split, they can't be a shortcut anyway
+	while(fscanf(f,"%255s",smiley)==1){
+		len = strlen(smiley);
 		num = strtoul(smiley, &end, 10);
-		if(end-smiley == strlen(smiley)){ /* this is a number */
+		if(end-smiley == len){ /* this is a number */
 			id=num+1; /* so we need increase id, and remap 0->1 */
 			last_mode = LAST_IS_NUMBER;
 			continue;
 		}
-		if(strlen(smiley)>3){
-			const char* ext = smiley+strlen(smiley)-3;
+		if(len>3){
+			const char* ext = smiley+len-3;
 			if(strcmp(ext,"gif")==0 || strcmp(ext,"png")==0){
-				strncpy(last_file, smiley, 256);
 				snprintf(last_file, sizeof(last_file), "%s/%s", file_dir, smiley);
 				last_mode = LAST_IS_PIC;
 				continue;
@@ -86,112 +118,162 @@ static void build_smiley_exp_from_file(char* exp,const char* path)
 		}
 
 		if(last_mode == LAST_IS_PIC){
-			purple_smiley_new_from_file(smiley, last_file);
+			add_smiley_pic(t, smiley, last_file, 1);
 		}
 		if(last_mode == LAST_IS_NUMBER){
-			//insert id->table map only once
-			if(smiley_tables[id-1]==NULL)
-				smiley_tables[id-1]=s_strdup(smiley);
+			//insert id->table map only once, compiled table goes first
+			if((id>SMILEY_FACE_MAX||smiley_face_shortcut[id-1]==NULL)
+					&& g_hash_table_lookup(t->local_face,(gpointer)id)==NULL)
+				g_hash_table_insert(t->local_face,(gpointer)id,g_strdup(smiley));
 			//insert hash table
-			g_hash_table_insert(smiley_hash,s_strdup(smiley),(gpointer)id);
-			if(smiley[0]==':'&&smiley[strlen(smiley)-1]==':'){
+			g_hash_table_insert(t->smiley_hash,g_strdup(smiley),(gpointer)id);
+			if(smiley[0]==':'&&smiley[len-1]==':'){
 				//move to next smiley
 				continue;
 			}
-			strcat(exp,"|");
-			beg = smiley;
-			do{
-				end=strpbrk(beg,spec_char);
-				if(end==NULL) strcat(exp,beg);
-				else {
-					strncat(exp, beg, end-beg);
-					strcat(exp,"\\");
-					strncat(exp,end,1);
-					beg = end+1;
-				}
-			}while(end);
+			ac_add(t->smiley_ac,smiley,len);
 		}
 	}
+	g_free(file_dir);
 	fclose(f);
 }
-static LwqqMsgContent* build_string_content(const char* from,const char* to,LwqqMsgMessage* msg)
+static size_t html_clean_span(const char* s,size_t len);
+static void paste_content_string(const char* from,size_t len,struct ds* to);
+//decode one of html_entity at p, return its length or 0
+static size_t lex_entity(const char* p,const char* to,char* c)
 {
-	LwqqMsgContent* c;
-	LwqqMsgContent* last;
-	const char *begin,*end,*read;
-	char* write;
-	if(to==NULL)to = from+strlen(from)+1;
-	last = TAILQ_LAST(&msg->content,LwqqMsgContentHead);
-	if(last && last->type == LWQQ_CONTENT_STRING){
-		c = NULL;//return NULL
-		size_t sz = strlen(last->data.str);
-		last->data.str = s_realloc(last->data.str,sz+to-from+3);
-		read = write = last->data.str+sz;
-	}else{
-		c = s_malloc0(sizeof(*c));
-		c->type = LWQQ_CONTENT_STRING;
-		c->data.str = s_malloc0(to-from+3);
-		read = write = c->data.str;
-	}
-	//initial value
-	strncpy(write,from,to-from);
-	write[to-from]='\0';
-	const char *ptr;
-	while(*read!='\0'){
-		if(!trex_search(hs_regex,read,&begin,&end)){
-			ptr = strchr(read,'\0');
-			ptr++;
-			memmove(write,read,ptr-read);
-			write+=ptr-read;
-			break;
+	int i;
+	for(i=0;i<sizeof(html_entity)/sizeof(html_entity[0]);i++){
+		if(to-p>=html_entity[i].len && memcmp(p,html_entity[i].name,html_entity[i].len)==0){
+			*c = html_entity[i].c;
+			return html_entity[i].len;
 		}
-		if(begin>read){
-			memmove(write,read,begin-read);
-			write+=(begin-read);
+	}
+	return 0;
+}
+//read next attribute of tag in [*p,e), value is unquoted.
+//return 0 when there is no more attribute
+static int lex_attr(const char** p,const char* e,const char** key,size_t* klen,const char** val,size_t* vlen)
+{
+	const char* s = *p;
+	while(s<e && isspace((unsigned char)*s)) s++;
+	*key = s;
+	while(s<e && *s!='=' && *s!='/' && !isspace((unsigned char)*s)) s++;
+	*klen = s-*key;
+	if(*klen==0) return 0;
+	*val = s;
+	*vlen = 0;
+	if(s<e && *s=='='){
+		char quote = 0;
+		s++;
+		if(s<e && (*s=='"'||*s=='\'')) quote = *s++;
+		*val = s;
+		while(s<e && (quote?*s!=quote:!isspace((unsigned char)*s))) s++;
+		*vlen = s-*val;
+		if(s<e && quote) s++;
+	}
+	*p = s;
+	return 1;
+}
+#define tag_is(name,len,str) (len==sizeof(str)-1 && g_ascii_strncasecmp(name,str,len)==0)
+//tag body is [s,e), without '<' and '>'.
+//only the subset of IMHTML pidgin sends is kept: br, b/i/u, font face/size/color, img src.
+static void lex_tag(const char* s,const char* e,LwqqMsgMessage* msg,struct ds* text)
+{
+	const char* name = s,*key,*val;
+	size_t len,klen,vlen;
+	if(*s=='/') return;
+	while(s<e && isalpha((unsigned char)*s)) s++;
+	len = s-name;
+	if(tag_is(name,len,"br")){
+		ds_pokes_n(*text,"\n",1);
+	}else if(tag_is(name,len,"b")){
+		lwqq_bit_set(msg->f_style, LWQQ_FONT_BOLD, 1);
+	}else if(tag_is(name,len,"i")){
+		lwqq_bit_set(msg->f_style, LWQQ_FONT_ITALIC, 1);
+	}else if(tag_is(name,len,"u")){
+		lwqq_bit_set(msg->f_style, LWQQ_FONT_UNDERLINE, 1);
+	}else if(tag_is(name,len,"img")){
+		while(lex_attr(&s,e,&key,&klen,&val,&vlen)){
+			if(tag_is(key,klen,"src")){
+				ds_pokes_n(*text,"<",1);
+				ds_pokes_n(*text,val,vlen);
+				ds_pokes_n(*text,">",1);
+				break;
+			}
 		}
-		const char s = html_map_to_key(begin);
-		if(s) *write++ = s;
-		else if(begin[0]=='<'){
-			if(begin[1]=='/'){
-			}else if(strncmp(begin, "<img ",5)==0){
-				char *end, *start = strstr(begin, "src=\"");
-				if(!start) goto failed;
-				start += 5;
-				end = strchr(start,'"');
-				if(!end) goto failed;
-				*write++ = '<';
-				strncpy(write, start, end-start);
-				write+=end-start;
-				*write++ = '>';
-			}else{
-				int s = style_map_to_key(begin);
-				if(s) lwqq_bit_set(msg->f_style, s, 1);
-				else if(strncmp(begin,"<font ",6)==0){
-					const char *key = begin+6;
-					const char *value = strchr(begin,'=')+2;
-					const char *end = strchr(value,'"');
-					if(strncmp(key,"size",4)==0){
-						int size = atoi(value);
-						msg->f_size = sizemap(size);
-					}else if(strncmp(key,"color",5)==0){
-						strncpy(msg->f_color,value+1,6);
-						msg->f_color[6] = '\0';
-					}else if(strncmp(key,"face",4)==0){
-						s_free(msg->f_name);
-						msg->f_name = s_malloc0(end-value+1);
-						strncpy(msg->f_name,value,end-value);
-						msg->f_name[end-value]='\0';
-					}
-				}
+	}else if(tag_is(name,len,"font")){
+		while(lex_attr(&s,e,&key,&klen,&val,&vlen)){
+			if(tag_is(key,klen,"size")){
+				msg->f_size = sizemap(atoi(val));
+			}else if(tag_is(key,klen,"color")){
+				if(vlen && *val=='#'){val++;vlen--;}
+				if(vlen>6) vlen = 6;
+				memcpy(msg->f_color,val,vlen);
+				msg->f_color[vlen] = '\0';
+			}else if(tag_is(key,klen,"face")){
+				s_free(msg->f_name);
+				msg->f_name = s_malloc0(vlen+1);
+				memcpy(msg->f_name,val,vlen);
 			}
 		}
-failed:
-		read = end;
 	}
-	*write = '\0';
-	return c;
 }
-static LwqqMsgContent* build_face_content(const char* face,int len)
+//decode html fragment [from,to) at the tail of text in a single pass.
+//text runs are copied in bulk, tags only update the style of msg.
+//the text is only turned into a string content by flush_string_content,
+//so a message mixing text and faces never copies the text twice.
+static void build_string_content(const char* from,const char* to,LwqqMsgMessage* msg,struct ds* text)
+{
+	struct ds buf = *text;
+	const char *p = from,*run = from,*e;
+	size_t n;
+	char c;
+	if(to==NULL) to = from+strlen(from);
+	//string content exists even when nothing is left after decoding
+	ds_sure(buf,to-from+1);
+	while(p<to){
+		p += html_clean_span(p,to-p);
+		if(p==to) break;
+		if(*p=='&' && (n = lex_entity(p,to,&c))){
+			ds_pokes_n(buf,run,p-run);
+			ds_pokes_n(buf,&c,1);
+			run = p = p+n;
+		}else if(*p=='<' && (e = memchr(p+1,'>',to-p-1)) && e>p+1){
+			ds_pokes_n(buf,run,p-run);
+			lex_tag(p+1,e,msg,&buf);
+			run = p = e+1;
+		}else
+			p++;
+	}
+	ds_pokes_n(buf,run,to-run);
+	*text = buf;
+}
+//hand the collected text over to a string content.
+//with echo set, the text is also rendered there as it would be displayed.
+static void flush_string_content(LwqqMsgMessage* msg,struct ds* text,struct ds* echo)
+{
+	struct ds empty = ds_initializer;
+	LwqqMsgContent* c;
+	if(ds_c_str(*text)==NULL) return;
+	if(echo){
+		const char* s = ds_c_str(*text);
+		size_t len = strlen(s);
+		if(utf8_valid_span(s, len) == len)
+			paste_content_string(s, len, echo);
+		else{
+			char* fixed = s_malloc(UTF8_SANITIZE_MAX(len));
+			paste_content_string(fixed, utf8_sanitize(s, len, fixed), echo);
+			s_free(fixed);
+		}
+	}
+	c = s_malloc0(sizeof(*c));
+	c->type = LWQQ_CONTENT_STRING;
+	c->data.str = ds_c_str(*text);
+	TAILQ_INSERT_TAIL(&msg->content,c,entries);
+	*text = empty;
+}
+static LwqqMsgContent* build_face_content(const qq_translator* t,const char* face,int len)
 {
 	char buf[20];
 	char* ptr = buf;
@@ -201,16 +283,17 @@ static LwqqMsgContent* build_face_content(const char* face,int len)
 	memcpy(ptr,face,len);
 	ptr[len]= '\0';
 	LwqqMsgContent* c;
-	if(smiley_hash==NULL) translate_global_init();
-	int num = (long)g_hash_table_lookup(smiley_hash,ptr);
-	if(num==0) return NULL;
+	//local overlay overrides the compiled table
+	int num = (long)g_hash_table_lookup(t->smiley_hash,ptr);
+	if(len>=20)
+		s_free(ptr);
 	//unshift face because when build it we shift it.
-	num--;
+	if(num) num--;
+	else num = smiley_builtin_lookup(face,len);
+	if(num<0) return NULL;
 	c = s_malloc0(sizeof(*c));
 	c->type = LWQQ_CONTENT_FACE;
 	c->data.face = num;
-	if(len>=20)
-		s_free(ptr);
 	return c;
 }
 static LwqqMsgContent* build_face_direct(int num)
@@ -221,36 +304,125 @@ static LwqqMsgContent* build_face_direct(int num)
 	c->data.face = num;
 	return c;
 }
-int translate_message_to_struct(LwqqClient* lc,const char* to,const char* what,LwqqMsg* msg,int using_cface)
+//render a face or image content of an outbound message for its echo
+static void echo_content(const LwqqMsgContent* c,struct ds* echo)
+{
+	struct ds buf = *echo;
+	char piece[32];
+	switch(c->type){
+		case LWQQ_CONTENT_FACE:
+			snprintf(piece, sizeof(piece), ":face%d:", c->data.face);
+			break;
+		case LWQQ_CONTENT_CFACE:
+			snprintf(piece, sizeof(piece), "<IMG ID=\"%d\">", s_atoi(c->data.cface.file_id,0));
+			break;
+		case LWQQ_CONTENT_OFFPIC:
+			snprintf(piece, sizeof(piece), "<IMG ID=\"%d\">", s_atoi(c->data.img.file_path,0));
+			break;
+		default:
+			return;
+	}
+	ds_cat(buf, piece);
+	*echo = buf;
+}
+/**
+ * outbound tokens, tried in this order on the leftmost position:
+ * <[^>]+> , :face\d+: , :-face: , literal smileys , :[^ :]+:
+ * each cached position stays valid while it is not before ptr,
+ * so a whole message is scanned in linear time.
+ */
+struct smiley_scan {
+	const AcAutomaton* ac;
+	const char* lit_b,*lit_e;//leftmost literal smiley, NULL if none left
+	const char* spec;//next '<' or ':', NULL if none left
+	const char* gt;//next '>', NULL if none left
+};
+#define scan_stale(p,ptr) ((p)!=NULL && (p)<(ptr))
+static void smiley_scan_init(struct smiley_scan* sc,const qq_translator* t,const char* str)
+{
+	sc->ac = t->smiley_ac;
+	ac_search(sc->ac,str,&sc->lit_b,&sc->lit_e);
+	sc->spec = strpbrk(str,"<:");
+	sc->gt = strchr(str,'>');
+}
+//<[^>]+> , :face\d+: or :-face:
+static const char* match_special(struct smiley_scan* sc,const char* s)
+{
+	const char* e;
+	if(*s=='<'){
+		if(scan_stale(sc->gt,s+1)) sc->gt = strchr(s+1,'>');
+		return (sc->gt && sc->gt>s+1)?sc->gt+1:NULL;
+	}
+	if(strncmp(s,":face",5)==0 && isdigit((unsigned char)s[5])){
+		for(e=s+6;isdigit((unsigned char)*e);e++);
+		if(*e==':') return e+1;
+	}
+	if(strncmp(s,":-face:",7)==0) return s+7;
+	return NULL;
+}
+//:[^ :]+:
+static const char* match_colon_word(const char* s)
+{
+	const char* e;
+	if(*s!=':') return NULL;
+	for(e=s+1;*e&&*e!=' '&&*e!=':';e++);
+	return (*e==':'&&e>s+1)?e+1:NULL;
+}
+static int smiley_search(struct smiley_scan* sc,const char* ptr,const char** begin,const char** end)
+{
+	const char* s;
+	if(scan_stale(sc->lit_b,ptr))
+		ac_search(sc->ac,ptr,&sc->lit_b,&sc->lit_e);
+	while(sc->spec){
+		if(sc->spec<ptr){
+			sc->spec = strpbrk(ptr,"<:");
+			continue;
+		}
+		s = sc->spec;
+		if(sc->lit_b && sc->lit_b<s) break;
+		if((*end = match_special(sc,s))){
+			*begin = s;
+			return 1;
+		}
+		//literal smiley is tried before :[^ :]+:
+		if(s==sc->lit_b) break;
+		if((*end = match_colon_word(s))){
+			*begin = s;
+			return 1;
+		}
+		sc->spec = strpbrk(s+1,"<:");
+	}
+	if(sc->lit_b==NULL) return 0;
+	*begin = sc->lit_b;
+	*end = sc->lit_e;
+	return 1;
+}
+//echo is the body of the html translate_struct_to_message would render from
+//msg with PURPLE_MESSAGE_SEND, it is built in the same pass when not NULL.
+static int message_to_struct(const qq_translator* t,const char* what,LwqqMsg* msg,int using_cface,struct ds* echo)
 {
 	const char* ptr = what;
 	int img_id;
 	LwqqMsgContent *c;
 	const char* begin,*end;
-	TRexMatch m;
-	if(_regex==NULL) translate_global_init();
-	TRex* x = _regex;
+	struct smiley_scan sc;
+	struct ds text = ds_initializer;
 	LwqqMsgMessage* mmsg = (LwqqMsgMessage*)msg;
 	int translate_face=1;
 
+	smiley_scan_init(&sc,t,what);
 	while(*ptr!='\0'){
 		c = NULL;
-		if(!trex_search(x,ptr,&begin,&end)){
+		if(!smiley_search(&sc,ptr,&begin,&end)){
 			///last part.
-			c = build_string_content(ptr,NULL,mmsg);
-			if(c) TAILQ_INSERT_TAIL(&mmsg->content,c,entries);
+			build_string_content(ptr,NULL,mmsg,&text);
 			//this is finished yet.
 			break;
 		}
 		if(begin>ptr){
 			//this is used to build string before match
-			//note you can not pass c directly. 
-			//because insert_tail is a macro.
-			c = build_string_content(ptr,begin,mmsg);
-			//you should insert twice now. like |inserted|begin|
-			if(c) TAILQ_INSERT_TAIL(&mmsg->content,c,entries);
+			build_string_content(ptr,begin,mmsg,&text);
 		}
-		trex_getsubexp(x,0,&m);
 		if(strncmp(begin,"<IMG ", 5)==0 && sscanf(begin,"<IMG ID=\"%d\">",&img_id)==1){
 			//processing purple internal img.
 			PurpleStoredImage* simg = purple_imgstore_find_by_id(img_id);
@@ -280,88 +452,691 @@ int translate_message_to_struct(LwqqClient* lc,const char* to,const char* what,L
 				translate_face=!translate_face;
 			}else{
 				//other :faces:
-				c = translate_face?build_face_content(m.begin, m.len):NULL;
-				if(c==NULL) c = build_string_content(begin, end, mmsg);
+				c = translate_face?build_face_content(t,begin, end-begin):NULL;
+				if(c==NULL) build_string_content(begin, end, mmsg, &text);
 			}
 		}else if(begin[0]==':'){
 			//other :)
-			c = translate_face?build_face_content(m.begin, m.len):NULL;
-			if(c==NULL) c = build_string_content(begin, end, mmsg);
+			c = translate_face?build_face_content(t,begin, end-begin):NULL;
+			if(c==NULL) build_string_content(begin, end, mmsg, &text);
 		}else if(begin[0]=='&'){
 		}else{
 			//other face with no fix style
-			c = translate_face?build_face_content(m.begin,m.len):NULL;
-			if(c==NULL) c = build_string_content(begin, end, mmsg);
+			c = translate_face?build_face_content(t,begin,end-begin):NULL;
+			if(c==NULL) build_string_content(begin, end, mmsg, &text);
 		}
 		ptr = end;
-		if(c!=NULL)
+		if(c!=NULL){
+			//keep the order like |text|c|
+			flush_string_content(mmsg,&text,echo);
 			lwqq_msg_content_append(mmsg, c);
+			if(echo) echo_content(c,echo);
+		}
 	}
+	flush_string_content(mmsg,&text,echo);
 	return 0;
 }
-static void paste_content_string(const char* from,struct ds* to)
+int translate_message_to_struct(const qq_translator* t,const char* to,const char* what,LwqqMsg* msg,int using_cface)
+{
+	return message_to_struct(t,what,msg,using_cface,NULL);
+}
+static const unsigned char html_spec_table[256] = {
+	['<'] = 1, ['>'] = 1, ['&'] = 1, ['"'] = 1, ['\''] = 1,
+};
+#if defined(__AVX2__) || defined(__SSE2__)
+#define SPEC_CMP(v,c) _mm_cmpeq_epi8(v,_mm_set1_epi8(c))
+//'<'|2 is '>' and '&'|1 is '\'', so the five symbols take three compares
+static inline __m128i html_spec16(const char* s)
+{
+	__m128i v = _mm_loadu_si128((const __m128i*)s);
+	return _mm_or_si128(
+			_mm_or_si128(SPEC_CMP(_mm_or_si128(v,_mm_set1_epi8(2)),'>'),
+				SPEC_CMP(_mm_or_si128(v,_mm_set1_epi8(1)),'\'')),
+			SPEC_CMP(v,'"'));
+}
+#endif
+#if defined(__AVX2__)
+static inline __m256i html_spec32(const char* s)
+{
+	__m256i v = _mm256_loadu_si256((const __m256i*)s);
+	return _mm256_or_si256(
+			_mm256_or_si256(
+				_mm256_cmpeq_epi8(_mm256_or_si256(v,_mm256_set1_epi8(2)),_mm256_set1_epi8('>')),
+				_mm256_cmpeq_epi8(_mm256_or_si256(v,_mm256_set1_epi8(1)),_mm256_set1_epi8('\''))),
+			_mm256_cmpeq_epi8(v,_mm256_set1_epi8('"')));
+}
+#endif
+//return the length of leading run which contains no HTML_SPEC_SYMBOL.
+//clean text is checked 64 bytes at a time, the block with a symbol is
+//searched again by the narrower loop below.
+static size_t html_clean_span(const char* s,size_t len)
+{
+	size_t i = 0;
+#if defined(__AVX2__)
+	for(;i+64<=len;i+=64)
+		if(_mm256_movemask_epi8(_mm256_or_si256(html_spec32(s+i),html_spec32(s+i+32)))) break;
+	for(;i+32<=len;i+=32){
+		unsigned mask = _mm256_movemask_epi8(html_spec32(s+i));
+		if(mask) return i+__builtin_ctz(mask);
+	}
+#elif defined(__SSE2__)
+	for(;i+64<=len;i+=64)
+		if(_mm_movemask_epi8(_mm_or_si128(
+						_mm_or_si128(html_spec16(s+i),html_spec16(s+i+16)),
+						_mm_or_si128(html_spec16(s+i+32),html_spec16(s+i+48))))) break;
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+	for(;i+16<=len;i+=16){
+		unsigned mask = _mm_movemask_epi8(html_spec16(s+i));
+		if(mask) return i+__builtin_ctz(mask);
+	}
+#endif
+	for(;i<len;i++)
+		if(html_spec_table[(unsigned char)s[i]]) return i;
+	return len;
+}
+//escape from into to, clean runs are copied in bulk
+static void paste_content_string(const char* from,size_t len,struct ds* to)
 {
 	const char* read = from;
-	const char* ptr = read;
+	const char* end = from+len;
 	struct ds write = *to;
 	size_t n = 0;
-	while((ptr = strpbrk(read,HTML_SPEC_SYMBOL))){
-		if(ptr>read){
-			n = ptr-read;
+	while(read<end){
+		n = html_clean_span(read, end-read);
+		if(n>0){
 			ds_pokes_n(write, read, n);
+			read += n;
 		}
-		ds_cat(write, to_html_symbol(*ptr));
-		read = ptr+1;
-	}
-	if(*read != '\0'){
-		ds_cat(write, read);
+		if(read==end) break;
+		ds_cat(write, to_html_symbol(*read));
+		read++;
 	}
 	*to = write;
 }
 char* translate_to_html_symbol(const char* s)
 {
 	struct ds buf = ds_initializer;
-	paste_content_string(s, &buf);
+	paste_content_string(s, strlen(s), &buf);
 	char* ret = ds_c_str(buf);
 	buf.d = NULL;
 	ds_free(buf);
 	return ret;
 }
-struct ds translate_struct_to_message(qq_account* ac, LwqqMsgMessage* msg, PurpleMessageFlags flags)
+//content addressed image table. the same sticker posted to many groups
+//shares one refcounted imgstore id instead of a copy for each message.
+//images are removed by image-deleting signal, the tables by img_table_free.
+static GHashTable* img_by_checksum;//key:sha1 string,value:imgstore id
+static GHashTable* checksum_by_img;//key:PurpleStoredImage*,value:sha1 string
+static int img_signal_handle;
+
+static void image_deleting(PurpleStoredImage* img, void* data)
+{
+	char* checksum = g_hash_table_lookup(checksum_by_img, img);
+	if(checksum == NULL) return;
+	g_hash_table_remove(checksum_by_img, img);
+	g_hash_table_remove(img_by_checksum, checksum);
+}
+static void img_table_free()
+{
+	if(img_by_checksum == NULL) return;
+	purple_signals_disconnect_by_handle(&img_signal_handle);
+	g_hash_table_destroy(checksum_by_img);
+	g_hash_table_destroy(img_by_checksum);
+	checksum_by_img = img_by_checksum = NULL;
+}
+//register image data to imgstore, it takes ownership of *data and checksum.
+//checksum is sha1 of data, computed here when NULL.
+//return a referenced imgstore id
+static int add_image(char** data, size_t size, char* checksum)
+{
+	if(img_by_checksum == NULL){
+		img_by_checksum = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+		checksum_by_img = g_hash_table_new(g_direct_hash, g_direct_equal);
+		purple_signal_connect(purple_imgstore_get_handle(), "image-deleting",
+				&img_signal_handle, PURPLE_CALLBACK(image_deleting), NULL);
+	}
+	if(checksum == NULL)
+		checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA1, (guchar*)*data, size);
+	int id = GPOINTER_TO_INT(g_hash_table_lookup(img_by_checksum, checksum));
+	if(id && purple_imgstore_find_by_id(id)){
+		//seen before, drop the duplicated buffer
+		purple_imgstore_ref_by_id(id);
+		s_free(*data);
+		g_free(checksum);
+	}else{
+		id = purple_imgstore_add_with_id(*data, size, NULL);
+		g_hash_table_insert(img_by_checksum, checksum, GINT_TO_POINTER(id));
+		g_hash_table_insert(checksum_by_img, purple_imgstore_find_by_id(id), checksum);
+	}
+	//let it freed by purple
+	*data = NULL;
+	return id;
+}
+//dark theme adapt: lighten each color channel to c/2+128
+#define DK1(i) ((i)/2+128)
+#define DK4(i) DK1(i),DK1(i+1),DK1(i+2),DK1(i+3)
+#define DK16(i) DK4(i),DK4(i+4),DK4(i+8),DK4(i+12)
+#define DK64(i) DK16(i),DK16(i+16),DK16(i+32),DK16(i+48)
+static const unsigned char dark_theme_lut[256] = {
+	DK64(0), DK64(64), DK64(128), DK64(192)
+};
+#undef DK64
+#undef DK16
+#undef DK4
+#undef DK1
+
+#define FONT_CACHE_SIZE 16
+#define FONT_CACHE_FLAGS (IGNORE_FONT_FACE|IGNORE_FONT_SIZE|DARK_THEME_ADAPT)
+//received message in a render independent form. it is rendered to html
+//by translate_ir_append, and can be rendered again later (e.g. when
+//group members are loaded) without parsing html back.
+enum ir_type {
+	IR_TEXT,///< plain text, escaped when rendered
+	IR_HTML,///< html placeholder, pasted as is
+	IR_RAW,///< string content of msg as is, see translate_ir_prepare
+	IR_FACE,
+	IR_IMAGE,
+	IR_EMOJI,
+};
+struct ir_node {
+	enum ir_type type;
+	union {
+		struct {size_t off,len;} text;///< slice of qq_msg_ir::text
+		char* raw;
+		int face;
+		///< held: ir owns a reference of id.
+		///< data: received image not registered to imgstore yet, see translate_ir_bind
+		struct {int id;int held;char* data;size_t size;char* checksum;} img;
+		///< id is 0 until bound, -1 when image is missing and text is shown
+		struct {size_t off,len;int idx;int id;} emoji;
+	} d;
+};
+//place of an image or emoji node in pre rendered html
+struct ir_slot {
+	size_t off;
+	size_t node;
+};
+struct ir_font {
+	char* name;
+	char* color;
+	int size;
+	int style;
+};
+struct qq_msg_ir {
+	PurpleMessageFlags flags;
+	struct ir_font font;
+	struct ds text;///< storage of all text runs, always valid utf-8
+	size_t text_len;
+	struct ir_node* node;
+	size_t nnode,cap;
+	//rendered by translate_ir_prepare, images are left to slots
+	struct ds html;
+	struct ir_slot* slot;
+	size_t nslot;
+};
+struct font_header {
+	char color[8];
+	char* name;
+	int size;
+	int style;
+	char* html;
+};
+struct qq_font_cache {
+	int flag;///< account flags the cached headers are rendered with
+	int next;///< next slot to be replaced
+	struct font_header ent[FONT_CACHE_SIZE];
+};
+
+//headers are rendered by translate threads too
+G_LOCK_DEFINE_STATIC(font_cache);
+
+static void font_cache_clear(struct qq_font_cache* cache)
+{
+	int i;
+	for(i=0;i<FONT_CACHE_SIZE;i++){
+		s_free(cache->ent[i].name);
+		s_free(cache->ent[i].html);
+	}
+	memset(cache->ent, 0, sizeof(cache->ent));
+	cache->next = 0;
+}
+void translate_font_cache_free(qq_account* ac)
+{
+	G_LOCK(font_cache);
+	if(ac->font_cache){
+		font_cache_clear(ac->font_cache);
+		s_free(ac->font_cache);
+		ac->font_cache = NULL;
+	}
+	G_UNLOCK(font_cache);
+}
+static char* render_font_header(int flag, const char* color_str, const char* name, int size, int style)
 {
-	LwqqMsgContent* c;
-	char piece[8192] = {0};
 	struct ds buf = ds_initializer;
-	ds_sure(buf, BUFLEN);
+	char color[16], size_str[16];
+	if(lwqq_bit_get(style,LWQQ_FONT_BOLD)) ds_cat(buf,"<b>");
+	if(lwqq_bit_get(style,LWQQ_FONT_ITALIC)) ds_cat(buf,"<i>");
+	if(lwqq_bit_get(style,LWQQ_FONT_UNDERLINE)) ds_cat(buf,"<u>");
+	if(flag&DARK_THEME_ADAPT){
+		unsigned long c = strtoul(color_str, NULL, 16);
+		unsigned long t = (c==0)?0xffffff:
+			dark_theme_lut[c&0xff]|dark_theme_lut[c>>8&0xff]<<8|dark_theme_lut[c>>16&0xff]<<16;
+		snprintf(color, sizeof(color), "%lx", t);
+		ds_cat(buf,"<font color=\"#",color,"\" ");
+	}else
+		ds_cat(buf,"<font color=\"#",color_str,"\" ");
+	if(!(flag&IGNORE_FONT_FACE)&&name)
+		ds_cat(buf,"face=\"",name,"\" ");
+	if(!(flag&IGNORE_FONT_SIZE)){
+		snprintf(size_str, sizeof(size_str), "%d", sizeunmap(size));
+		ds_cat(buf,"size=\"",size_str,"\" ");
+	}
+	ds_cat(buf,">");
+	return ds_c_str(buf);
+}
+//find the rendered header of font tuple from account cache,
+//render and remember it when missing. return NULL if it can't be cached
+static const char* cached_font_header(qq_account* ac, const struct ir_font* font)
+{
+	struct qq_font_cache* cache = ac->font_cache;
+	int flag = ac->flag&FONT_CACHE_FLAGS;
+	//fields ignored by account flags are not a part of key
+	const char* name = (flag&IGNORE_FONT_FACE)?NULL:font->name;
+	int size = (flag&IGNORE_FONT_SIZE)?0:font->size;
+	struct font_header* h;
+	int i;
+
+	if(cache == NULL){
+		cache = ac->font_cache = s_malloc0(sizeof(*cache));
+		cache->flag = flag;
+	}else if(cache->flag != flag){
+		font_cache_clear(cache);
+		cache->flag = flag;
+	}
+	//too long to be a key, let caller render it directly
+	if(strlen(font->color)>=sizeof(h->color)) return NULL;
+
+	for(i=0;i<FONT_CACHE_SIZE;i++){
+		h = &cache->ent[i];
+		if(h->html == NULL) break;
+		if(h->size == size && h->style == font->style
+				&& strcmp(h->color, font->color)==0
+				&& ((!h->name&&!name)||(h->name&&name&&strcmp(h->name,name)==0)))
+			return h->html;
+	}
+	h = &cache->ent[cache->next];
+	cache->next = (cache->next+1)%FONT_CACHE_SIZE;
+	s_free(h->name);
+	s_free(h->html);
+	strcpy(h->color, font->color);
+	h->name = s_strdup(name);
+	h->size = size;
+	h->style = font->style;
+	h->html = render_font_header(flag, font->color, name, size, font->style);
+	return h->html;
+}
+static void paste_font_header(qq_account* ac, const struct ir_font* font, struct ds* to)
+{
+	struct ds buf = *to;
+	const char* header;
+	G_LOCK(font_cache);
+	//header is only valid while the cache is locked
+	if((header = cached_font_header(ac, font))) ds_cat(buf, header);
+	G_UNLOCK(font_cache);
+	if(header == NULL){
+		char* html = render_font_header(ac->flag, font->color, font->name, font->size, font->style);
+		ds_cat(buf, html);
+		s_free(html);
+	}
+	*to = buf;
+}
+static void paste_font_footer(const struct ir_font* font, struct ds* to)
+{
+	struct ds buf = *to;
+	ds_cat(buf,"</font>");
+	//close in reverse order of header
+	if(lwqq_bit_get(font->style,LWQQ_FONT_UNDERLINE)) ds_cat(buf,"</u>");
+	if(lwqq_bit_get(font->style,LWQQ_FONT_ITALIC)) ds_cat(buf,"</i>");
+	if(lwqq_bit_get(font->style,LWQQ_FONT_BOLD)) ds_cat(buf,"</b>");
+	*to = buf;
+}
+static struct ir_node* ir_push(qq_msg_ir* ir, enum ir_type type)
+{
+	if(ir->nnode == ir->cap){
+		ir->cap = ir->cap?ir->cap*2:8;
+		ir->node = s_realloc(ir->node, sizeof(*ir->node)*ir->cap);
+	}
+	ir->node[ir->nnode].type = type;
+	return &ir->node[ir->nnode++];
+}
+static void ir_push_text(qq_msg_ir* ir, enum ir_type type, const char* s, size_t len)
+{
+	struct ir_node* n = ir_push(ir, type);
+	n->d.text.off = ir->text_len;
+	n->d.text.len = len;
+	ds_pokes_n(ir->text, s, len);
+	ir->text_len += len;
+}
+//like ir_push_text, the text is escaped into IR_HTML
+static void ir_push_escaped(qq_msg_ir* ir, const char* s, size_t len)
+{
+	struct ir_node* n = ir_push(ir, IR_HTML);
+	n->d.text.off = ir->text_len;
+	paste_content_string(s, len, &ir->text);
+	//escaped length is only known after pasting, measure the tail
+	n->d.text.len = ds_c_str(ir->text)?strlen(ds_c_str(ir->text)+ir->text_len):0;
+	ir->text_len += n->d.text.len;
+}
+static struct ir_node* ir_push_image(qq_msg_ir* ir, int id, int held)
+{
+	struct ir_node* n = ir_push(ir, IR_IMAGE);
+	memset(&n->d.img, 0, sizeof(n->d.img));
+	n->d.img.id = id;
+	n->d.img.held = held;
+	return n;
+}
+//load resource file rel, like "baozou/01.gif", into a g_malloc'ed copy.
+//a loose file in user config dir overrides the bundle, without the
+//bundle it falls back to loose file in RES_DIR.
+//packed data is still copied once: imgstore takes ownership of the buffer
+//and frees it, it can't point into the mapping. the bundle saves the
+//open and read of each file, not this copy.
+static gchar* res_load(const qq_translator* t, const char* rel, size_t* size)
+{
+	char path[1024];
+	const char* packed;
+	gchar* data;
+	gsize len;
+	if(t->res && !g_hash_table_lookup(t->res_override, rel)
+			&& (packed = res_pack_find(t->res, rel, size)))
+#if GLIB_CHECK_VERSION(2,68,0)
+		return g_memdup2(packed, *size);
+#else
+		return g_memdup(packed, *size);
+#endif
+	if(g_hash_table_lookup(t->res_override, rel))
+		snprintf(path, sizeof(path), "%s"LWQQ_PATH_SEP"%s", lwdb_get_config_dir(), rel);
+	else
+		snprintf(path, sizeof(path), "%s"LWQQ_PATH_SEP"%s", RES_DIR, rel);
+	if(!g_file_get_contents(path, &data, &len, NULL)) return NULL;
+	*size = len;
+	return data;
+}
+//list user overrides once, so loading needs no probing
+static void res_scan_override(qq_translator* t)
+{
+	char path[1024];
+	const char* name;
+	GDir* dir;
+	int i;
+	t->res_override = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	for(i=0;i<sizeof(res_pack_dirs)/sizeof(res_pack_dirs[0]);i++){
+		snprintf(path, sizeof(path), "%s"LWQQ_PATH_SEP"%s", lwdb_get_config_dir(), res_pack_dirs[i]);
+		if((dir = g_dir_open(path, 0, NULL)) == NULL) continue;
+		while((name = g_dir_read_name(dir)))
+			g_hash_table_insert(t->res_override, g_strdup_printf("%s/%s", res_pack_dirs[i], name), GINT_TO_POINTER(1));
+		g_dir_close(dir);
+	}
+}
+//registration state of translator->pic, 0 not yet, 1 registered to purple,
+//-1 image can't be loaded. main thread only.
+static signed char* pic_state;
+//conversation -> bitset of translator->pic already delivered to it.
+//image data is shared by purple smiley, a conversation only gets a copy of
+//the smileys its messages used.
+static GHashTable* pic_delivered;
+
+static void add_smiley_to_conv(PurpleConversation* conv,PurpleSmiley* smiley);
+static int register_smiley_pic(const qq_translator* t, int idx)
+{
+	const struct smiley_pic_entry* e = &t->pic[idx];
+	PurpleSmiley* smiley;
+	gchar* data;
+	size_t size;
+	gsize len;
+	//purple_smiley_new returns an existing smiley and drops nothing, so the
+	//image would leak. reuse it before loading anything
+	if(purple_smileys_find_by_shortcut(e->shortcut)) return 1;
+	if(e->local){
+		if(g_file_get_contents(e->file, &data, &len, NULL)) size = len;
+		else data = NULL;
+	}else
+		data = res_load(t, e->file, &size);
+	if(data == NULL) return -1;
+	const char* name = strrchr(e->file,'/');
+	//smiley takes the image reference
+	smiley = purple_smiley_new(purple_imgstore_add(data, size, name?name+1:e->file), e->shortcut);
+	return smiley?1:-1;
+}
+//deliver picture smileys used by message to its conversation, each one is
+//registered on its first use and written once per conversation. markup is
+//skipped as the outbound lexer does, a shortcut inside a tag (href, alt)
+//isn't a smiley.
+static gboolean smiley_pic_writing(PurpleAccount* account, const char* who, char** message,
+		PurpleConversation* conv, PurpleMessageFlags flags, void* data)
+{
+	const qq_translator* t = translator;
+	const char* ptr,* b,* e,* lt,* gt;
+	unsigned char* sent = NULL;
+	PurpleSmiley* smiley;
+	int idx,cur;
+	if(t == NULL || conv == NULL || message == NULL || *message == NULL) return FALSE;
+	if(strcmp(purple_account_get_protocol_id(account), "prpl-webqq")!=0) return FALSE;
+	ptr = *message;
+	lt = strchr(ptr, '<');
+	gt = strchr(ptr, '>');
+	idx = ac_search(t->pic_ac, ptr, &b, &e);
+	while(idx>=0){
+		if(scan_stale(lt, ptr)) lt = strchr(ptr, '<');
+		//<[^>]+> before the match is a tag, see match_special
+		if(lt && lt<b){
+			if(scan_stale(gt, lt+1)) gt = strchr(lt+1, '>');
+			if(gt && gt>lt+1){
+				ptr = gt+1;
+				if(b<ptr) idx = ac_search(t->pic_ac, ptr, &b, &e);
+			}
+			lt = strchr(lt+1, '<');
+			continue;
+		}
+		cur = idx;
+		ptr = e;
+		idx = ac_search(t->pic_ac, ptr, &b, &e);
+		if(pic_state[cur]==0)
+			pic_state[cur] = register_smiley_pic(t, cur);
+		if(pic_state[cur]<0) continue;
+		if(sent == NULL && (sent = g_hash_table_lookup(pic_delivered, conv)) == NULL){
+			sent = g_malloc0(t->npic/8+1);
+			g_hash_table_insert(pic_delivered, conv, sent);
+		}
+		if(sent[cur/8] & (1<<cur%8)) continue;
+		if((smiley = purple_smileys_find_by_shortcut(t->pic[cur].shortcut)) == NULL) continue;
+		add_smiley_to_conv(conv, smiley);
+		sent[cur/8] |= 1<<cur%8;
+	}
+	return FALSE;
+}
+static void smiley_pic_conv_deleted(PurpleConversation* conv, void* data)
+{
+	if(pic_delivered) g_hash_table_remove(pic_delivered, conv);
+}
+//imgstore id of emoji_table, loaded on first use and kept until the
+//translator is freed. 0 is not loaded yet, -1 can't be loaded.
+//main thread only.
+static int emoji_img[EMOJI_NUM];
+#define VS16 "\xEF\xB8\x8F"
+
+static void emoji_img_free()
+{
+	int i;
+	for(i=0;i<EMOJI_NUM;i++)
+		if(emoji_img[i]>0) purple_imgstore_unref_by_id(emoji_img[i]);
+	memset(emoji_img, 0, sizeof(emoji_img));
+}
+static int emoji_image(const qq_translator* t, int idx)
+{
+	char rel[64];
+	gchar* data;
+	size_t size;
+	if(emoji_img[idx]) return emoji_img[idx]>0?emoji_img[idx]:0;
+	snprintf(rel, sizeof(rel), "emoji/%s", emoji_table[idx].file);
+	if((data = res_load(t, rel, &size)) == NULL){
+		emoji_img[idx] = -1;
+		return 0;
+	}
+	emoji_img[idx] = purple_imgstore_add_with_id(data, size, emoji_table[idx].file);
+	return emoji_img[idx];
+}
+//first entry of emoji_table starting with cp, single one sorts first
+static int emoji_first(uint32_t cp)
+{
+	int lo = 0, hi = EMOJI_NUM;
+	while(lo<hi){
+		int mid = (lo+hi)/2;
+		if(emoji_table[mid].cp[0]<cp) lo = mid+1;
+		else hi = mid;
+	}
+	return (lo<EMOJI_NUM && emoji_table[lo].cp[0]==cp)?lo:-1;
+}
+static int emoji_pair(int first, uint32_t cp)
+{
+	int i;
+	for(i=first;i<EMOJI_NUM && emoji_table[i].cp[0]==emoji_table[first].cp[0];i++)
+		if(emoji_table[i].cp[1]==cp) return i;
+	return -1;
+}
+//s is valid utf-8
+static uint32_t utf8_decode(const unsigned char* s, size_t* n)
+{
+	if(s[0]<0x80){*n = 1;return s[0];}
+	if(s[0]<0xE0){*n = 2;return (s[0]&0x1F)<<6|(s[1]&0x3F);}
+	if(s[0]<0xF0){*n = 3;return (s[0]&0x0F)<<12|(s[1]&0x3F)<<6|(s[2]&0x3F);}
+	*n = 4;
+	return (s[0]&0x07)<<18|(s[1]&0x3F)<<12|(s[2]&0x3F)<<6|(s[3]&0x3F);
+}
+//skip to the first byte which could start an emoji. emoji_gen makes sure
+//emoji_lead only has these leads: non BMP range and three BMP blocks.
+static size_t emoji_skip(const unsigned char* s, size_t len)
+{
+	size_t i = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+	const __m128i f0 = _mm_set1_epi8((char)0xF0);
+	for(;i+16<=len;i+=16){
+		__m128i v = _mm_loadu_si128((const __m128i*)(s+i));
+		__m128i m = _mm_or_si128(
+				_mm_or_si128(SPEC_CMP(v,(char)0xC2),SPEC_CMP(v,(char)0xE2)),
+				_mm_or_si128(SPEC_CMP(v,(char)0xE3),_mm_cmpeq_epi8(_mm_max_epu8(v,f0),v)));
+		unsigned mask = _mm_movemask_epi8(m);
+		if(mask) return i+__builtin_ctz(mask);
+	}
+#endif
+	for(;i<len;i++)
+		if(emoji_lead[s[i]]) return i;
+	return len;
+}
+//find the first emoji in valid utf-8 s[0,len), return its emoji_table
+//index and set [*b,*e), or return -1.
+//a trailing U+FE0F is a part of emoji, keycap is "#️⃣". entries with vs16,
+//like © or "#⃣", are text without U+FE0F and are not matched.
+static int emoji_search(const char* str, size_t len, size_t* b, size_t* e)
+{
+	const unsigned char* s = (const unsigned char*)str;
+	size_t i = 0, n, m, j;
+	int idx, pair, vs16;
+	while((i += emoji_skip(s+i, len-i)) < len){
+		uint32_t cp = utf8_decode(s+i, &n);
+		if(cp == EMOJI_KEYCAP){
+			if(i>=4 && memcmp(s+i-3, VS16, 3)==0 && s[i-4]<0x80
+					&& (idx = emoji_first(s[i-4]))>=0
+					&& (pair = emoji_pair(idx, cp))>=0){
+				*b = i-4;
+				*e = i+n;
+				return pair;
+			}
+		}else if((idx = emoji_first(cp))>=0){
+			j = i+n;
+			vs16 = j+3<=len && memcmp(s+j, VS16, 3)==0;
+			if(vs16) j += 3;
+			if(j<len && (pair = emoji_pair(idx, utf8_decode(s+j, &m)))>=0
+					&& (vs16 || !emoji_table[pair].vs16)){
+				*b = i;
+				*e = j+m;
+				return pair;
+			}
+			if(emoji_table[idx].cp[1] == 0 && (vs16 || !emoji_table[idx].vs16)){
+				*b = i;
+				*e = j;
+				return idx;
+			}
+		}
+		i += n;
+	}
+	return -1;
+}
+static void ir_push_run(qq_msg_ir* ir, const char* s, size_t len, int escape)
+{
+	if(escape) ir_push_escaped(ir, s, len);
+	else ir_push_text(ir, IR_TEXT, s, len);
+}
+//text from server may carry broken sequences, they are replaced by U+FFFD
+//once here, so every text run of ir is known valid utf-8.
+//with emoji set, known emoji are split out, translate_ir_bind gives them
+//images. with escape set, text runs are escaped into html right away.
+static void ir_push_utf8(qq_msg_ir* ir, const char* s, size_t len, int emoji, int escape)
+{
+	char* fixed = NULL;
+	size_t from = 0, pos = 0, b, e;
+	struct ir_node* n;
+	int idx;
+	if(utf8_valid_span(s, len) != len){
+		fixed = s_malloc(UTF8_SANITIZE_MAX(len));
+		len = utf8_sanitize(s, len, fixed);
+		s = fixed;
+	}
+	while(emoji && pos<len && (idx = emoji_search(s+pos, len-pos, &b, &e))>=0){
+		b += pos;
+		pos = e+pos;
+		if(b>from) ir_push_run(ir, s+from, b-from, escape);
+		//emoji has nothing to escape, it is kept to be shown without image
+		n = ir_push(ir, IR_EMOJI);
+		n->d.emoji.off = ir->text_len;
+		n->d.emoji.len = pos-b;
+		n->d.emoji.idx = idx;
+		n->d.emoji.id = 0;
+		ds_pokes_n(ir->text, s+b, pos-b);
+		ir->text_len += pos-b;
+		from = pos;
+	}
+	if(len>from || from==0) ir_push_run(ir, s+from, len-from, escape);
+	s_free(fixed);
+}
+//with steal set, string contents are moved out of msg as IR_RAW
+static qq_msg_ir* ir_from_struct(qq_account* ac, LwqqMsgMessage* msg, PurpleMessageFlags flags, int steal)
+{
+	LwqqMsgContent* c;
+	qq_msg_ir* ir = s_malloc0(sizeof(*ir));
 	char* img_idstr = NULL, **img_data = NULL, *img_url = NULL;
 	size_t img_sz = 0;
-	if(lwqq_bit_get(msg->f_style,LWQQ_FONT_BOLD)) ds_cat(buf,"<b>");
-	if(lwqq_bit_get(msg->f_style,LWQQ_FONT_ITALIC)) ds_cat(buf,"<i>");
-	if(lwqq_bit_get(msg->f_style,LWQQ_FONT_UNDERLINE)) ds_cat(buf,"<u>");
-	strcpy(piece, "");
-	if(ac->flag&DARK_THEME_ADAPT){
-		int c = strtoul(msg->f_color, NULL, 16);
-		int t = (c==0)?0xffffff:(c%256)/2+128+((c/256%256)/2+128)*256+((c/256/256%256)/2+128)*256*256;
-		format_append(piece,"color=\"#%x\" ",t);
-	}else
-		format_append(piece,"color=\"#%s\" ",msg->f_color);
-	if(!(ac->flag&IGNORE_FONT_FACE)&&msg->f_name)
-		format_append(piece,"face=\"%s\" ",msg->f_name);
-	if(!(ac->flag&IGNORE_FONT_SIZE))
-		format_append(piece,"size=\"%d\" ",sizeunmap(msg->f_size));
-	ds_cat(buf, "<font ", piece, ">");
+
+	ir->flags = flags;
+	ir->font.name = s_strdup(msg->f_name);
+	ir->font.color = s_strdup(msg->f_color);
+	ir->font.size = msg->f_size;
+	ir->font.style = msg->f_style;
 
 	TAILQ_FOREACH(c, &msg->content, entries) {
 		switch(c->type){
 			case LWQQ_CONTENT_STRING:
-				paste_content_string(c->data.str, &buf);
+				if(steal){
+					if(c->data.str == NULL) break;
+					ir_push(ir, IR_RAW)->d.raw = c->data.str;
+					c->data.str = NULL;
+				}else
+					ir_push_utf8(ir, c->data.str, strlen(c->data.str),
+							!(flags & PURPLE_MESSAGE_SEND), 0);
 				break;
 			case LWQQ_CONTENT_FACE:
-				if(flags & PURPLE_MESSAGE_SEND){
-					snprintf(piece, sizeof(piece), ":face%d:",c->data.face);
-					ds_cat(buf, piece);
-				} else
-					ds_cat(buf, translate_smile(c->data.face));
+				ir_push(ir, IR_FACE)->d.face = c->data.face;
 				break;
 			case LWQQ_CONTENT_OFFPIC:
 			case LWQQ_CONTENT_CFACE:
@@ -378,96 +1153,311 @@ struct ds translate_struct_to_message(qq_account* ac, LwqqMsgMessage* msg, Purpl
 				}
 				if(flags & PURPLE_MESSAGE_SEND) {
 					int img_id = s_atoi(img_idstr,0);
-					snprintf(piece, sizeof(piece), "<IMG ID=\"%4d\">", img_id);
-					ds_cat(buf, piece);
+					int held = purple_imgstore_find_by_id(img_id)!=NULL;
+					if(held) purple_imgstore_ref_by_id(img_id);
+					ir_push_image(ir, img_id, held);
+				}else if(img_sz>0){
+					//steal the buffer, it is registered by translate_ir_bind
+					struct ir_node* n = ir_push_image(ir, 0, 0);
+					n->d.img.data = *img_data;
+					n->d.img.size = img_sz;
+					*img_data = NULL;
 				}else{
-					if(img_sz>0){
-						int img_id = purple_imgstore_add_with_id(*img_data,img_sz,NULL);
-						//let it freed by purple
-						*img_data = NULL;
-						//make it room to change num if necessary.
-						snprintf(piece,sizeof(piece),"<IMG ID=\"%4d\">",img_id);
-						ds_cat(buf, piece);
+					struct ds html = ds_initializer;
+					if((msg->super.super.type==LWQQ_MS_GROUP_MSG&&ac->flag&NOT_DOWNLOAD_GROUP_PIC)){
+						ds_cat(html,_("【DISABLE PIC】"));
+					}else if(img_url){
+						ds_cat(html, "<a href=\"", img_url, "\">", _("【PIC】"), "</a>");
 					}else{
-						if((msg->super.super.type==LWQQ_MS_GROUP_MSG&&ac->flag&NOT_DOWNLOAD_GROUP_PIC)){
-							ds_cat(buf,_("【DISABLE PIC】"));
-						}else if(img_url){
-							snprintf(piece,sizeof(piece), "<a href=\"%s\">%s</a>",
-									img_url, _("【PIC】") );
-							ds_cat(buf, piece);
-						}else{
-							ds_cat(buf,_("【PIC NOT FOUND】"));
-						}
+						ds_cat(html,_("【PIC NOT FOUND】"));
 					}
+					ir_push_text(ir, IR_HTML, ds_c_str(html), strlen(ds_c_str(html)));
+					ds_free(html);
 				}
 				break;
 		}
 	}
-	ds_cat(buf,"</font>");
-	if(lwqq_bit_get(msg->f_style,LWQQ_FONT_BOLD)) ds_cat(buf,"</u>");
-	if(lwqq_bit_get(msg->f_style,LWQQ_FONT_ITALIC)) ds_cat(buf,"</i>");
-	if(lwqq_bit_get(msg->f_style,LWQQ_FONT_UNDERLINE)) ds_cat(buf,"</b>");
-	return buf;
+	return ir;
 }
-void translate_global_init()
+qq_msg_ir* translate_struct_to_ir_deferred(qq_account* ac, LwqqMsgMessage* msg, PurpleMessageFlags flags)
 {
-	if(_regex==NULL){
-		const char* err = NULL;
-		char *smiley_exp = s_malloc0(2048);
-		smiley_hash = g_hash_table_new_full(g_str_hash,g_str_equal,NULL,NULL);
-		char path[1024];
-		strcat(smiley_exp,REGEXP_HEAD);
-		build_smiley_exp_from_file(smiley_exp, GLOBAL_SMILEY_PATH(path));
-		build_smiley_exp_from_file(smiley_exp, LOCAL_SMILEY_PATH(path));
-		strcat(smiley_exp,REGEXP_TAIL);
-		_regex = trex_compile(_TREXC(smiley_exp),&err);
-		if(err) {lwqq_puts(err);assert(0);}
-		free(smiley_exp);
-		assert(_regex!=NULL);
+	return ir_from_struct(ac, msg, flags, 1);
+}
+qq_msg_ir* translate_struct_to_ir(qq_account* ac, LwqqMsgMessage* msg, PurpleMessageFlags flags)
+{
+	qq_msg_ir* ir = ir_from_struct(ac, msg, flags, 0);
+	translate_ir_bind(ac, ir);
+	return ir;
+}
+//render ir at the tail of to. with slot set, images and emoji are left
+//out, and their places are written to slot in order.
+static void ir_render(qq_account* ac, const qq_msg_ir* ir, struct ds* to, struct ir_slot* slot)
+{
+	struct ds buf = *to;
+	char piece[32];
+	size_t i,len = 0;
+
+	//reserve a little more for escaped symbol and tags
+	ds_sure(buf, 128 + ir->text_len + ir->text_len/8 + ir->nnode*32
+			+ (ir->font.name?strlen(ir->font.name):0));
+	paste_font_header(ac, &ir->font, &buf);
+	for(i=0;i<ir->nnode;i++){
+		const struct ir_node* n = &ir->node[i];
+		if(slot && (n->type == IR_IMAGE || n->type == IR_EMOJI)){
+			//only measure what was added since the last slot
+			len += strlen(ds_c_str(buf)+len);
+			slot->off = len;
+			slot->node = i;
+			slot++;
+			continue;
+		}
+		switch(n->type){
+			case IR_TEXT:
+				paste_content_string(ds_c_str(ir->text)+n->d.text.off, n->d.text.len, &buf);
+				break;
+			case IR_HTML:
+				ds_pokes_n(buf, ds_c_str(ir->text)+n->d.text.off, n->d.text.len);
+				break;
+			case IR_RAW:
+				//translate_ir_prepare wasn't called, nothing is known about it
+				paste_content_string(n->d.raw, strlen(n->d.raw), &buf);
+				break;
+			case IR_FACE:
+				if(ir->flags & PURPLE_MESSAGE_SEND){
+					snprintf(piece, sizeof(piece), ":face%d:",n->d.face);
+					ds_cat(buf, piece);
+				} else
+					ds_cat(buf, translate_smile(ac->translator, n->d.face, piece, sizeof(piece)));
+				break;
+			case IR_IMAGE:
+				snprintf(piece, sizeof(piece), "<IMG ID=\"%d\">", n->d.img.id);
+				ds_cat(buf, piece);
+				break;
+			case IR_EMOJI:
+				if(n->d.emoji.id>0){
+					snprintf(piece, sizeof(piece), "<IMG ID=\"%d\">", n->d.emoji.id);
+					ds_cat(buf, piece);
+				}else
+					ds_pokes_n(buf, ds_c_str(ir->text)+n->d.emoji.off, n->d.emoji.len);
+				break;
+		}
 	}
-	if(hs_regex==NULL){
-		const char* err = NULL;
-		hs_regex = trex_compile(_TREXC(HTML_SYMBOL),&err);
-		if(err){lwqq_puts(err);assert(0);}
-		assert(_regex!=NULL);
+	paste_font_footer(&ir->font, &buf);
+	*to = buf;
+}
+//touch nothing but ir and immutable data of ac, so it can run on a worker
+//thread. string contents are checked, split and escaped, images get their
+//checksum, then ir is rendered to html with a slot for each image.
+void translate_ir_prepare(qq_account* ac, qq_msg_ir* ir)
+{
+	struct ir_node* old = ir->node;
+	size_t i,nold = ir->nnode;
+	//a string content becomes several nodes, list them again
+	ir->node = NULL;
+	ir->nnode = ir->cap = 0;
+	for(i=0;i<nold;i++){
+		struct ir_node* n = &old[i];
+		if(n->type == IR_RAW){
+			ir_push_utf8(ir, n->d.raw, strlen(n->d.raw), !(ir->flags & PURPLE_MESSAGE_SEND), 1);
+			s_free(n->d.raw);
+			continue;
+		}
+		if(n->type == IR_IMAGE && n->d.img.data && n->d.img.checksum == NULL)
+			n->d.img.checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA1,
+					(guchar*)n->d.img.data, n->d.img.size);
+		*ir_push(ir, n->type) = *n;
 	}
+	s_free(old);
+	ir->nslot = 0;
+	for(i=0;i<ir->nnode;i++)
+		if(ir->node[i].type == IR_IMAGE || ir->node[i].type == IR_EMOJI) ir->nslot++;
+	ir->slot = s_malloc0(sizeof(*ir->slot)*(ir->nslot+1));
+	ir_render(ac, ir, &ir->html, ir->slot);
 }
-void remove_all_smiley(void* data,void* userdata)
+//main thread only, images waiting in ir are registered to imgstore and
+//emoji get their images. the reference from add_image belongs to rendered
+//html, ir holds one more of its own.
+void translate_ir_bind(qq_account* ac, qq_msg_ir* ir)
 {
-	purple_smiley_delete((PurpleSmiley*)data);
+	size_t i;
+	for(i=0;i<ir->nnode;i++){
+		struct ir_node* n = &ir->node[i];
+		if(n->type == IR_EMOJI && n->d.emoji.id == 0){
+			n->d.emoji.id = emoji_image(ac->translator, n->d.emoji.idx);
+			if(n->d.emoji.id == 0) n->d.emoji.id = -1;
+			continue;
+		}
+		if(n->type != IR_IMAGE || n->d.img.data == NULL) continue;
+		n->d.img.id = add_image(&n->d.img.data, n->d.img.size, n->d.img.checksum);
+		n->d.img.checksum = NULL;
+		purple_imgstore_ref_by_id(n->d.img.id);
+		n->d.img.held = 1;
+	}
 }
-void translate_global_free()
+void translate_ir_append(qq_account* ac, const qq_msg_ir* ir, struct ds* to)
 {
-	if(_regex){
-		trex_free(_regex);
-		_regex = NULL;
+	struct ds buf = *to;
+	char piece[32];
+	const char* html = ds_c_str(ir->html);
+	size_t i,from = 0;
+	if(html == NULL){
+		ir_render(ac, ir, to, NULL);
+		return;
 	}
-	if(hs_regex){
-		trex_free(hs_regex);
-		hs_regex = NULL;
+	//only images are left to fill, pre rendered html is copied around them
+	ds_sure(buf, strlen(html) + ir->nslot*32 + 1);
+	for(i=0;i<ir->nslot;i++){
+		const struct ir_node* n = &ir->node[ir->slot[i].node];
+		ds_pokes_n(buf, html+from, ir->slot[i].off-from);
+		from = ir->slot[i].off;
+		if(n->type == IR_EMOJI && n->d.emoji.id<=0){
+			ds_pokes_n(buf, ds_c_str(ir->text)+n->d.emoji.off, n->d.emoji.len);
+			continue;
+		}
+		snprintf(piece, sizeof(piece), "<IMG ID=\"%d\">",
+				n->type == IR_EMOJI?n->d.emoji.id:n->d.img.id);
+		ds_cat(buf, piece);
 	}
-	if(smiley_hash) {
-		g_hash_table_remove_all(smiley_hash);
-		smiley_hash = NULL;
-		GList* list = purple_smileys_get_all();
-		g_list_foreach(list,remove_all_smiley,NULL);
-		g_list_free(list);
+	ds_cat(buf, html+from);
+	*to = buf;
+}
+void translate_ir_free(qq_msg_ir* ir)
+{
+	size_t i;
+	if(ir == NULL) return;
+	for(i=0;i<ir->nnode;i++){
+		if(ir->node[i].type == IR_RAW) s_free(ir->node[i].d.raw);
+		if(ir->node[i].type != IR_IMAGE) continue;
+		if(ir->node[i].d.img.held)
+			purple_imgstore_unref_by_id(ir->node[i].d.img.id);
+		s_free(ir->node[i].d.img.data);
+		g_free(ir->node[i].d.img.checksum);
 	}
+	ds_free(ir->text);
+	ds_free(ir->html);
+	s_free(ir->slot);
+	s_free(ir->node);
+	s_free(ir->font.name);
+	s_free(ir->font.color);
+	s_free(ir);
 }
-const char* translate_smile(int face)
+void translate_struct_append_message(qq_account* ac, LwqqMsgMessage* msg, PurpleMessageFlags flags, struct ds* to)
 {
-	static char buf[64];
-	if(smiley_tables[face]!=NULL)
-		strcpy(buf,smiley_tables[face]);
-	else
-		snprintf(buf, sizeof(buf), ":face%d:",face);
+	qq_msg_ir* ir = translate_struct_to_ir(ac, msg, flags);
+	translate_ir_append(ac, ir, to);
+	translate_ir_free(ir);
+}
+struct ds translate_struct_to_message(qq_account* ac, LwqqMsgMessage* msg, PurpleMessageFlags flags)
+{
+	struct ds buf = ds_initializer;
+	translate_struct_append_message(ac, msg, flags, &buf);
+	return buf;
+}
+int translate_message_to_struct_echo(qq_account* ac,const char* to,const char* what,LwqqMsg* msg,int using_cface,struct ds* echo)
+{
+	LwqqMsgMessage* mmsg = (LwqqMsgMessage*)msg;
+	struct ds body = ds_initializer;
+	struct ir_font font;
+	int ret;
+	ret = message_to_struct(ac->translator, what, msg, using_cface, &body);
+	//tags of what could change the font, header is known only now
+	font.name = mmsg->f_name;
+	font.color = mmsg->f_color;
+	font.size = mmsg->f_size;
+	font.style = mmsg->f_style;
+	paste_font_header(ac, &font, echo);
+	if(ds_c_str(body)){
+		struct ds buf = *echo;
+		ds_pokes_n(buf, ds_c_str(body), strlen(ds_c_str(body)));
+		*echo = buf;
+	}
+	paste_font_footer(&font, echo);
+	ds_free(body);
+	return ret;
+}
+static void remove_all_smiley(void* data,void* userdata)
+{
+	purple_smiley_delete((PurpleSmiley*)data);
+}
+qq_translator* qq_translator_ref()
+{
+	if(translator){
+		translator->ref++;
+		return translator;
+	}
+	qq_translator* t = s_malloc0(sizeof(*t));
+	char path[1024];
+	int i;
+	t->ref = 1;
+	t->smiley_hash = g_hash_table_new_full(g_str_hash,g_str_equal,g_free,NULL);
+	t->local_face = g_hash_table_new_full(g_direct_hash,g_direct_equal,NULL,g_free);
+	t->smiley_ac = ac_new();
+	assert(t->smiley_ac!=NULL);
+	for(i=0;i<SMILEY_LITERAL_NUM;i++)
+		ac_add(t->smiley_ac,smiley_literal[i],strlen(smiley_literal[i]));
+	snprintf(path,sizeof(path),"%s"LWQQ_PATH_SEP"webqq.pack",RES_DIR);
+	t->res = res_pack_open(path);
+	res_scan_override(t);
+	//picture smileys are registered to purple on first use
+	t->pic_ac = ac_new();
+	assert(t->pic_ac!=NULL);
+	for(i=0;i<SMILEY_PIC_NUM;i++)
+		add_smiley_pic(t, smiley_pic[i].shortcut, smiley_pic[i].file, 0);
+	load_smiley_from_file(t, LOCAL_SMILEY_PATH(path));
+	ac_compile(t->smiley_ac);
+	ac_compile(t->pic_ac);
+	pic_state = s_malloc0(t->npic+1);
+	pic_delivered = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+	purple_signal_connect(purple_conversations_get_handle(), "writing-im-msg",
+			&translator, PURPLE_CALLBACK(smiley_pic_writing), NULL);
+	purple_signal_connect(purple_conversations_get_handle(), "writing-chat-msg",
+			&translator, PURPLE_CALLBACK(smiley_pic_writing), NULL);
+	purple_signal_connect(purple_conversations_get_handle(), "deleting-conversation",
+			&translator, PURPLE_CALLBACK(smiley_pic_conv_deleted), NULL);
+	translator = t;
+	return t;
+}
+void qq_translator_unref(qq_translator* t)
+{
+	int i;
+	if(t==NULL || --t->ref>0) return;
+	ac_free(t->smiley_ac);
+	g_hash_table_destroy(t->smiley_hash);
+	g_hash_table_destroy(t->local_face);
+	g_hash_table_destroy(t->res_override);
+	res_pack_close(t->res);
+	purple_signals_disconnect_by_handle(&translator);
+	for(i=0;i<t->npic;i++){
+		s_free(t->pic[i].shortcut);
+		s_free(t->pic[i].file);
+	}
+	s_free(t->pic);
+	ac_free(t->pic_ac);
+	s_free(pic_state);
+	pic_state = NULL;
+	g_hash_table_destroy(pic_delivered);
+	pic_delivered = NULL;
+	s_free(t);
+	translator = NULL;
+	emoji_img_free();
+	img_table_free();
+	GList* list = purple_smileys_get_all();
+	g_list_foreach(list,remove_all_smiley,NULL);
+	g_list_free(list);
+}
+const char* translate_smile(const qq_translator* t,int face,char* buf,size_t size)
+{
+	const char* shortcut;
+	if(face>=0 && face<SMILEY_FACE_MAX && smiley_face_shortcut[face])
+		return smiley_face_shortcut[face];
+	if((shortcut = g_hash_table_lookup(t->local_face,(gpointer)(long)(face+1))))
+		return shortcut;
+	snprintf(buf, size, ":face%d:",face);
 	return buf;
 }
 
-static void add_smiley(void* data,void* userdata)
+static void add_smiley_to_conv(PurpleConversation* conv,PurpleSmiley* smiley)
 {
-	PurpleConversation* conv = userdata;
-	PurpleSmiley* smiley = data;
 	const char* shortcut = purple_smiley_get_shortcut(smiley);
 	purple_conv_custom_smiley_add(conv,shortcut,NULL,NULL,0);
 	size_t len;
@@ -475,15 +1465,5 @@ static void add_smiley(void* data,void* userdata)
 	purple_conv_custom_smiley_write(conv,shortcut,d,len);
 	purple_conv_custom_smiley_close(conv,shortcut);
 }
-void translate_add_smiley_to_conversation(PurpleConversation* conv)
-{
-	GList* list = purple_smileys_get_all();
-	if(list == NULL){
-		translate_global_init();
-		list = purple_smileys_get_all();
-	}
-	g_list_foreach(list,add_smiley,conv);
-	g_list_free(list);
-}
 
 // vim: tabstop=3 sw=3 sts=3 noexpandtab
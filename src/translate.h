@@ -3,11 +3,39 @@
 #include <msg.h>
 #include "qq_types.h"
 
-void translate_global_init();
-void translate_global_free();
-int translate_message_to_struct(LwqqClient* lc,const char* to,const char* what,LwqqMsg*,int using_cface);
+/** shared smiley data, the first reference builds it, picture smileys are
+ * registered and delivered to a conversation when its messages use them */
+qq_translator* qq_translator_ref();
+/** the last reference frees it and removes smileys */
+void qq_translator_unref(qq_translator* t);
+int translate_message_to_struct(const qq_translator* t,const char* to,const char* what,LwqqMsg*,int using_cface);
+/**
+ * translate_message_to_struct, and render the local echo of msg at the tail
+ * of echo in the same pass. echo equals translate_struct_to_message with
+ * PURPLE_MESSAGE_SEND.
+ */
+int translate_message_to_struct_echo(qq_account* ac,const char* to,const char* what,LwqqMsg* msg,int using_cface,struct ds* echo);
 struct ds translate_struct_to_message(qq_account* ac, LwqqMsgMessage* msg, PurpleMessageFlags flags);
-void translate_add_smiley_to_conversation(PurpleConversation* conv);
-const char* translate_smile(int face);
+/** render msg at the tail of to */
+void translate_struct_append_message(qq_account* ac, LwqqMsgMessage* msg, PurpleMessageFlags flags, struct ds* to);
+/** render independent form of a received message, see translate.c */
+typedef struct qq_msg_ir qq_msg_ir;
+/** take images out of msg and keep its text, faces and font */
+qq_msg_ir* translate_struct_to_ir(qq_account* ac, LwqqMsgMessage* msg, PurpleMessageFlags flags);
+/**
+ * like translate_struct_to_ir, but only moves string contents and images
+ * out of msg. the rest is done by translate_ir_prepare and translate_ir_bind.
+ */
+qq_msg_ir* translate_struct_to_ir_deferred(qq_account* ac, LwqqMsgMessage* msg, PurpleMessageFlags flags);
+/** check, escape and render text and hash images of deferred ir, safe on any thread */
+void translate_ir_prepare(qq_account* ac, qq_msg_ir* ir);
+/** register images and emoji to imgstore, main thread only */
+void translate_ir_bind(qq_account* ac, qq_msg_ir* ir);
+/** render ir at the tail of to, could be called many times */
+void translate_ir_append(qq_account* ac, const qq_msg_ir* ir, struct ds* to);
+void translate_ir_free(qq_msg_ir* ir);
+/** return shortcut of face, fallback ":faceN:" is formatted in buf */
+const char* translate_smile(const qq_translator* t,int face,char* buf,size_t size);
 char* translate_to_html_symbol(const char* s);
+void translate_font_cache_free(qq_account* ac);
 #endif
@@ -0,0 +1,176 @@
+#include <string.h>
+#include "utf8.h"
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+//length of the valid sequence at s, or 0 and *bad is set to the length of
+//its maximal invalid subpart, which is replaced as a whole.
+static size_t seq_len(const unsigned char* s,size_t len,size_t* bad)
+{
+	unsigned char c = s[0];
+	unsigned char lo = 0x80,hi = 0xBF;
+	size_t n,i;
+	if(c<0x80) return 1;
+	if(c<0xC2){*bad = 1;return 0;}
+	if(c<0xE0) n = 2;
+	else if(c<0xF0){
+		n = 3;
+		if(c==0xE0) lo = 0xA0;//overlong
+		else if(c==0xED) hi = 0x9F;//surrogate
+	}else if(c<0xF5){
+		n = 4;
+		if(c==0xF0) lo = 0x90;//overlong
+		else if(c==0xF4) hi = 0x8F;//above U+10FFFF
+	}else{*bad = 1;return 0;}
+	for(i=1;i<n;i++){
+		if(i>=len || s[i]<lo || s[i]>hi){*bad = i;return 0;}
+		lo = 0x80;
+		hi = 0xBF;
+	}
+	return n;
+}
+static size_t scalar_span(const unsigned char* s,size_t len)
+{
+	size_t i = 0,n,bad;
+	while(i<len){
+		if((n = seq_len(s+i,len-i,&bad))==0) break;
+		i += n;
+	}
+	return i;
+}
+
+#if defined(__SSSE3__)
+//lookup validation of Keiser and Lemire: every pair of adjacent bytes is
+//classified by three nibble tables, a byte pair is bad when all of its
+//three classes share a bit. 3rd and 4th byte continuations are checked by
+//looking back 2 and 3 bytes.
+#define TOO_SHORT  (1<<0)
+#define TOO_LONG   (1<<1)
+#define OVERLONG_3 (1<<2)
+#define TOO_LARGE  (1<<3)
+#define SURROGATE  (1<<4)
+#define OVERLONG_2 (1<<5)
+#define TOO_LARGE_1000 (1<<6)
+#define OVERLONG_4 (1<<6)
+#define TWO_CONTS  (1<<7)
+#define CARRY (TOO_SHORT|TOO_LONG|TWO_CONTS)
+
+static __m128i block_error(__m128i in,__m128i prev)
+{
+	const __m128i nibble = _mm_set1_epi8(0x0F);
+	const __m128i byte_1_high_tbl = _mm_setr_epi8(
+			TOO_LONG,TOO_LONG,TOO_LONG,TOO_LONG,
+			TOO_LONG,TOO_LONG,TOO_LONG,TOO_LONG,
+			TWO_CONTS,TWO_CONTS,TWO_CONTS,TWO_CONTS,
+			TOO_SHORT|OVERLONG_2,
+			TOO_SHORT,
+			TOO_SHORT|OVERLONG_3|SURROGATE,
+			TOO_SHORT|TOO_LARGE|TOO_LARGE_1000|OVERLONG_4);
+	const __m128i byte_1_low_tbl = _mm_setr_epi8(
+			CARRY|OVERLONG_3|OVERLONG_2|OVERLONG_4,
+			CARRY|OVERLONG_2,
+			CARRY,
+			CARRY,
+			CARRY|TOO_LARGE,
+			CARRY|TOO_LARGE|TOO_LARGE_1000,
+			CARRY|TOO_LARGE|TOO_LARGE_1000,
+			CARRY|TOO_LARGE|TOO_LARGE_1000,
+			CARRY|TOO_LARGE|TOO_LARGE_1000,
+			CARRY|TOO_LARGE|TOO_LARGE_1000,
+			CARRY|TOO_LARGE|TOO_LARGE_1000,
+			CARRY|TOO_LARGE|TOO_LARGE_1000,
+			CARRY|TOO_LARGE|TOO_LARGE_1000,
+			CARRY|TOO_LARGE|TOO_LARGE_1000|SURROGATE,
+			CARRY|TOO_LARGE|TOO_LARGE_1000,
+			CARRY|TOO_LARGE|TOO_LARGE_1000);
+	const __m128i byte_2_high_tbl = _mm_setr_epi8(
+			TOO_SHORT,TOO_SHORT,TOO_SHORT,TOO_SHORT,
+			TOO_SHORT,TOO_SHORT,TOO_SHORT,TOO_SHORT,
+			TOO_LONG|OVERLONG_2|TWO_CONTS|OVERLONG_3|TOO_LARGE_1000|OVERLONG_4,
+			TOO_LONG|OVERLONG_2|TWO_CONTS|OVERLONG_3|TOO_LARGE,
+			TOO_LONG|OVERLONG_2|TWO_CONTS|SURROGATE|TOO_LARGE,
+			TOO_LONG|OVERLONG_2|TWO_CONTS|SURROGATE|TOO_LARGE,
+			TOO_SHORT,TOO_SHORT,TOO_SHORT,TOO_SHORT);
+	__m128i prev1 = _mm_alignr_epi8(in,prev,15);
+	__m128i prev2 = _mm_alignr_epi8(in,prev,14);
+	__m128i prev3 = _mm_alignr_epi8(in,prev,13);
+	__m128i sc = _mm_and_si128(
+			_mm_and_si128(
+				_mm_shuffle_epi8(byte_1_high_tbl,_mm_and_si128(_mm_srli_epi16(prev1,4),nibble)),
+				_mm_shuffle_epi8(byte_1_low_tbl,_mm_and_si128(prev1,nibble))),
+			_mm_shuffle_epi8(byte_2_high_tbl,_mm_and_si128(_mm_srli_epi16(in,4),nibble)));
+	//only 111xxxxx two bytes back or 1111xxxx three bytes back reach 0x80
+	__m128i must23 = _mm_or_si128(
+			_mm_subs_epu8(prev2,_mm_set1_epi8((char)(0xE0-0x80))),
+			_mm_subs_epu8(prev3,_mm_set1_epi8((char)(0xF0-0x80))));
+	return _mm_xor_si128(_mm_and_si128(must23,_mm_set1_epi8((char)0x80)),sc);
+}
+#undef TOO_SHORT
+#undef TOO_LONG
+#undef OVERLONG_3
+#undef TOO_LARGE
+#undef SURROGATE
+#undef OVERLONG_2
+#undef TOO_LARGE_1000
+#undef OVERLONG_4
+#undef TWO_CONTS
+#undef CARRY
+#endif
+
+size_t utf8_valid_span(const char* str,size_t len)
+{
+	const unsigned char* s = (const unsigned char*)str;
+	size_t i = 0,k;
+#if defined(__SSSE3__)
+	__m128i prev = _mm_setzero_si128();
+	for(;i+16<=len;i+=16){
+		__m128i in = _mm_loadu_si128((const __m128i*)(s+i));
+		//ascii block is fine unless last block left a sequence open
+		if(_mm_movemask_epi8(in)!=0 || (_mm_movemask_epi8(prev)&0xE000)){
+			__m128i err = block_error(in,prev);
+			if(_mm_movemask_epi8(_mm_cmpeq_epi8(err,_mm_setzero_si128()))!=0xFFFF)
+				break;
+		}
+		prev = in;
+	}
+#elif defined(__SSE2__)
+	//only skip ascii blocks, leave others to scalar
+	for(;i+16<=len;i+=16){
+		if(_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(s+i)))) break;
+	}
+#endif
+	//a block only knows a sequence started in the last 3 bytes before it
+	//is finished when it checks the next one, so scalar takes over from
+	//the first byte of such a sequence
+	for(k=i;k>0 && i-k<3;k--){
+		if((s[k-1]&0xC0)!=0x80){
+			if(s[k-1]>=0xC0) i = k-1;
+			break;
+		}
+	}
+	return i+scalar_span(s+i,len-i);
+}
+
+size_t utf8_sanitize(const char* s,size_t len,char* out)
+{
+	size_t r = 0,w = 0,n,bad;
+	while(r<len){
+		n = utf8_valid_span(s+r,len-r);
+		memcpy(out+w,s+r,n);
+		r += n;
+		w += n;
+		if(r==len) break;
+		//seq_len only sets bad for an invalid sequence, which the span
+		//stops at. a valid one would still step over a byte
+		bad = 1;
+		seq_len((const unsigned char*)s+r,len-r,&bad);
+		r += bad;
+		memcpy(out+w,"\xEF\xBF\xBD",3);
+		w += 3;
+	}
+	return w;
+}
@@ -0,0 +1,21 @@
+#ifndef UTF8_H_H
+#define UTF8_H_H
+#include <stddef.h>
+
+/**
+ * utf-8 validation of text received from server.
+ * valid means well formed by unicode: no overlong form, no surrogate,
+ * nothing above U+10FFFF and no truncated sequence.
+ */
+
+/** length of the longest valid prefix of s[0,len) */
+size_t utf8_valid_span(const char* s,size_t len);
+/** replacement of an invalid sequence costs at most this much */
+#define UTF8_SANITIZE_MAX(len) ((len)*3)
+/**
+ * copy s[0,len) to out, every maximal invalid subpart is replaced by
+ * U+FFFD. out holds UTF8_SANITIZE_MAX(len) bytes, return bytes written.
+ */
+size_t utf8_sanitize(const char* s,size_t len,char* out);
+
+#endif
@@ -34,7 +34,6 @@
 #define OPEN_URL(var,url) snprintf(var,sizeof(var),"xdg-open '%s'",url);
 
 char *qq_get_cb_real_name(PurpleConnection *gc, int id, const char *who);
-static void client_connect_signals(PurpleConnection* gc);
 static void whisper_message_delay_display(qq_account* ac,LwqqGroup* group,char* from,char* msg,time_t t);
 static void friend_avatar(qq_account* ac,LwqqBuddy* buddy);
 static void group_avatar(LwqqAsyncEvent* ev,LwqqGroup* group);
@@ -111,6 +110,18 @@ static const char* local_id_to_serv(qq_account* ac,const char* local_id)
 	return g_hash_table_lookup(table,QQ_ROOM_TYPE);
 	}
 	*/
+//chat key is try_get(account,gid), discu has no account so only its gid is
+//looked up, it is never in qqnumber index
+static LwqqGroup* find_group_by_chat_key(LwqqClient* lc,const char* key,const char* type)
+{
+	LwqqGroup* ret;
+	if(type && strcmp(type,QQ_ROOM_TYPE_DISCU)==0)
+		return find_group_by_gid(lc,key);
+	ret = find_group_by_qqnumber(lc,key);
+	if(ret == NULL)
+		ret = find_group_by_gid(lc,key);
+	return ret;
+}
 static LwqqGroup* qq_get_group_from_chat(PurpleChat* chat)
 {
 	PurpleAccount* account = purple_chat_get_account(chat);
@@ -120,9 +131,7 @@ static LwqqGroup* qq_get_group_from_chat(PurpleChat* chat)
 	LwqqGroup* ret = NULL;
 	GHashTable* table = purple_chat_get_components(chat);
 	const char* key = g_hash_table_lookup(table,QQ_ROOM_KEY_GID);
-	ret = find_group_by_qqnumber(lc, key);
-	if(ret == NULL)
-		ret = find_group_by_gid(lc,key);
+	ret = find_group_by_chat_key(lc, key, g_hash_table_lookup(table,QQ_ROOM_TYPE));
 	return ret;
 }
 //#define get_name_from_chat(chat) (g_hash_table_lookup(purple_chat_get_components(chat),QQ_ROOM_KEY_GID));
@@ -291,7 +300,7 @@ static void all_reset(qq_account* ac,int opt)
 							if((strcmp(type,QQ_ROOM_TYPE_DISCU)==0 && opt & RESET_DISCU_SOFT ) || 
 									(strcmp(type,QQ_ROOM_TYPE_QUN)==0 && opt & RESET_GROUP_SOFT)){
 								const char* name = get_name_from_chat(chat);
-								if(lwqq_group_find_group_by_qqnumber(ac->qq,name)==NULL)
+								if(find_group_by_qqnumber(ac->qq,name)==NULL)
 									purple_blist_remove_chat(chat);
 							}else
 								purple_blist_remove_chat(chat);
@@ -417,7 +426,11 @@ static void create_discu(qq_account* ac,PurpleRequestFields* root)
 		piece = strtrim(piece);
 		if(strcmp(piece,"")==0) continue;
 		LwqqBuddy* b = find_buddy_by_qqnumber(lc, piece);
-		if(b == NULL) b = lwqq_buddy_find_buddy_by_name(lc, piece);
+		if(b == NULL){
+			//names aren't indexed
+			qq_account_linear_lookup(ac, "buddy name", piece);
+			b = lwqq_buddy_find_buddy_by_name(lc, piece);
+		}
 		if(b) lwqq_discu_add_buddy(chg, b);
 		else format_append(err, "%s\n", piece);
 	}
@@ -703,15 +716,154 @@ static void group_come(LwqqClient* lc,LwqqGroup** p_group)
 	ac->disable_send_server = 0;
 }
 #define discu_come(lc,data) (group_come(lc,data))
+//received message on its way to conversation. with translate_threads set
+//its text is checked, escaped and rendered and its images are hashed by a
+//worker thread, main thread only binds images and shows it. jobs are shown
+//in arriving order, a finished job waits for all jobs before it, so no
+//conversation sees its messages reordered. without it the job lives on
+//stack of the caller and is translated and shown at once.
+struct recv_job {
+	LwqqMsgType type;
+	char* who;
+	char* gid;///< group may be deleted before it is shown, look it up again
+	char* prefix;///< "(#seq)" of group message
+	char* notice;///< error line shown before group message
+	time_t when;
+	qq_msg_ir* ir;
+	int done;
+	int local;///< on caller's stack, ir is bound and msg is left intact
+};
+static void buddy_message_show(qq_account* ac,struct recv_job* job);
+static void group_message_show(qq_account* ac,struct recv_job* job);
+static void whisper_message_show(qq_account* ac,struct recv_job* job);
+
+//strings of msg are moved into a job for translate_pool, local is used
+//when there is no pool
+static struct recv_job* recv_job_new(qq_account* ac,LwqqMsgMessage* msg,struct recv_job* local)
+{
+	struct recv_job* job;
+	if(ac->translate_pool == NULL){
+		job = local;
+		memset(job,0,sizeof(*job));
+		job->local = 1;
+		job->ir = translate_struct_to_ir(ac,msg,PURPLE_MESSAGE_RECV);
+	}else{
+		job = s_malloc0(sizeof(*job));
+		job->ir = translate_struct_to_ir_deferred(ac,msg,PURPLE_MESSAGE_RECV);
+	}
+	job->type = msg->super.super.type;
+	job->when = msg->time;
+	return job;
+}
+static void recv_job_free(struct recv_job* job)
+{
+	s_free(job->who);
+	s_free(job->gid);
+	s_free(job->prefix);
+	s_free(job->notice);
+	translate_ir_free(job->ir);
+	if(!job->local) s_free(job);
+}
+static void recv_job_show(qq_account* ac,struct recv_job* job)
+{
+	if(!job->local) translate_ir_bind(ac,job->ir);
+	switch(job->type){
+		case LWQQ_MS_BUDDY_MSG:
+			buddy_message_show(ac,job);
+			break;
+		case LWQQ_MS_SESS_MSG:
+			whisper_message_show(ac,job);
+			break;
+		default:
+			group_message_show(ac,job);
+			break;
+	}
+	recv_job_free(job);
+}
+static gboolean recv_job_flush(gpointer data)
+{
+	qq_account* ac = data;
+	struct recv_job* job;
+	//recv_idle is guarded by the lock of recv_done, a job finished after
+	//it is cleared posts a new flush
+	g_async_queue_lock(ac->recv_done);
+	ac->recv_idle = 0;
+	while((job = g_async_queue_try_pop_unlocked(ac->recv_done)))
+		job->done = 1;
+	g_async_queue_unlock(ac->recv_done);
+	while((job = g_queue_peek_head(ac->recv_jobs)) && job->done){
+		g_queue_pop_head(ac->recv_jobs);
+		recv_job_show(ac,job);
+	}
+	return FALSE;
+}
+//worker thread, touch nothing but job and immutable data of ac.
+//finished job is posted back, main thread is woken once for a batch.
+//purple eventloop is main thread only, an idle source is added to the
+//default context of glib instead, which is safe from any thread.
+static void recv_job_translate(gpointer data,gpointer user_data)
+{
+	struct recv_job* job = data;
+	qq_account* ac = user_data;
+	translate_ir_prepare(ac,job->ir);
+	g_async_queue_lock(ac->recv_done);
+	g_async_queue_push_unlocked(ac->recv_done,job);
+	if(ac->recv_idle == 0)
+		ac->recv_idle = g_idle_add(recv_job_flush,ac);
+	g_async_queue_unlock(ac->recv_done);
+}
+static void recv_job_submit(qq_account* ac,struct recv_job* job)
+{
+	if(job->local){
+		recv_job_show(ac,job);
+		return;
+	}
+	g_queue_push_tail(ac->recv_jobs,job);
+	g_thread_pool_push(ac->translate_pool,job,NULL);
+}
+static void recv_job_start(qq_account* ac,int threads)
+{
+#if !GLIB_CHECK_VERSION(2,32,0)
+	if(!g_thread_supported()) g_thread_init(NULL);
+#endif
+	ac->recv_done = g_async_queue_new();
+	ac->recv_jobs = g_queue_new();
+	ac->translate_pool = g_thread_pool_new(recv_job_translate,ac,threads,FALSE,NULL);
+}
+static void recv_job_stop(qq_account* ac)
+{
+	struct recv_job* job;
+	if(ac->recv_jobs == NULL) return;
+	//wait running jobs, not yet started ones are dropped. no worker is
+	//left after it, so recv_idle is only touched here
+	if(ac->translate_pool) g_thread_pool_free(ac->translate_pool,TRUE,TRUE);
+	ac->translate_pool = NULL;
+	if(ac->recv_idle) g_source_remove(ac->recv_idle);
+	ac->recv_idle = 0;
+	while(g_async_queue_try_pop(ac->recv_done));
+	g_async_queue_unref(ac->recv_done);
+	ac->recv_done = NULL;
+	while((job = g_queue_pop_head(ac->recv_jobs)))
+		recv_job_free(job);
+	g_queue_free(ac->recv_jobs);
+	ac->recv_jobs = NULL;
+}
 static void buddy_message(LwqqClient* lc,LwqqMsgMessage* msg)
 {
 	qq_account* ac = lwqq_client_userdata(lc);
-	PurpleConnection* pc = ac->gc;
 	LwqqBuddy* buddy = msg->buddy.from;
 	const char* local_id = (ac->flag&QQ_USE_QQNUM)?buddy->qqnumber:buddy->uin;
 
-	struct ds body = translate_struct_to_message(ac,msg,PURPLE_MESSAGE_RECV);
-	serv_got_im(pc, local_id, ds_c_str(body), PURPLE_MESSAGE_RECV, msg->time);
+	struct recv_job local;
+	struct recv_job* job = recv_job_new(ac,msg,&local);
+	job->who = s_strdup(local_id);
+	recv_job_submit(ac,job);
+}
+static void buddy_message_show(qq_account* ac,struct recv_job* job)
+{
+	struct ds body = ds_initializer;
+	translate_ir_append(ac,job->ir,&body);
+	serv_got_im(ac->gc, job->who, ds_c_str(body), PURPLE_MESSAGE_RECV, job->when);
 	ds_free(body);
 }
 static void offline_file(LwqqClient* lc,LwqqMsgOffFile* msg)
@@ -852,89 +1004,95 @@ static void sys_g_message(LwqqClient* lc,LwqqMsgSysGMsg* msg)
 	purple_notify_message(ac->gc, PURPLE_NOTIFY_MSG_INFO, _("QQ Group Sys Message"), body,NULL, NULL, NULL);
 	qq_system_log(ac,body);
 }
-struct rewrite_pic_entry {
+//group message arrived before members are loaded. it is shown with raw
+//uin as sender first, then shown again when members are loaded so sender
+//gets its name. only the sender changes, the same html is shown again.
+struct rewrite_msg_entry {
 	LwqqGroup* owner;
-	int ori_id;
-	int new_id;
+	char* who;
+	time_t when;
+	char* what;///< html shown first time, to find it in history
+	qq_msg_ir* ir;///< holds images of what until it is shown again
 };
+static void rewrite_msg_entry_free(struct rewrite_msg_entry* entry)
+{
+	s_free(entry->who);
+	s_free(entry->what);
+	translate_ir_free(entry->ir);
+	s_free(entry);
+}
+//pending entry shown as message, the same html goes first, then the same
+//sender since a writing signal could change the html.
+static GList* find_rewrite_entry(GList* pending,const PurpleConvMessage* message)
+{
+	GList* item,* by_who = NULL;
+	struct rewrite_msg_entry* entry;
+	for(item=pending;item;item=item->next){
+		entry = item->data;
+		if(entry->when != message->when) continue;
+		if(strcmp(entry->what,message->what)==0) return item;
+		if(by_who == NULL && strcmp(entry->who,message->who)==0) by_who = item;
+	}
+	return by_who;
+}
 static void rewrite_whole_message_list(LwqqAsyncEvent* ev,qq_account* ac,LwqqGroup* group)
 {
 	if(ev->result != LWQQ_EC_OK) return;
 	qq_chat_group* cg = group->data;
 	qq_cgroup_flush_members(cg);
 
-	PurpleConversation* conv = CGROUP_GET_CONV(cg);
-	if(conv == NULL){
-		//only do free work.
-		GList* item = ac->rewrite_pic_list,*safe;
-		struct rewrite_pic_entry* entry;
-		while(item){
-			entry = item->data;
-			safe = item;
-			item = item->next;
-			if(entry->owner == group){
-				purple_imgstore_unref_by_id(entry->new_id);
-				ac->rewrite_pic_list = g_list_remove_link(ac->rewrite_pic_list,safe);
-			}
+	//take entries of this group out, list is newest first
+	//so pending is in arriving order
+	GList* item = ac->rewrite_msg_list,*safe;
+	GList* pending = NULL;
+	struct rewrite_msg_entry* entry;
+	while(item){
+		safe = item;
+		item = item->next;
+		entry = safe->data;
+		if(entry->owner == group){
+			ac->rewrite_msg_list = g_list_remove_link(ac->rewrite_msg_list,safe);
+			pending = g_list_concat(safe,pending);
 		}
-		return;
 	}
-	GList* list = purple_conversation_get_message_history(conv);
+
+	PurpleConversation* conv = CGROUP_GET_CONV(cg);
+	GList* list = conv?purple_conversation_get_message_history(conv):NULL;
 	GList* newlist = NULL;
 	PurpleConvMessage* message,* newmsg;
-	const char* pic;
-	char buf[6]={0};
 	while(list){
 		message = list->data;
 		newmsg = s_malloc0(sizeof(*newmsg));
 		newmsg->what = s_strdup(message->what);
-		pic = newmsg->what;
-		if(strstr(pic,"<IMG")==NULL){
-		}else{
-			char* beg;
-			//beg = message->what;
-			//inplace replace id num with new id;
-			while((pic = strstr(pic,"<IMG")) != NULL){
-				int id,new_id = 0;
-				sscanf(pic,"<IMG ID=\"%d\"",&id);
-				GList* item = ac->rewrite_pic_list;
-				struct rewrite_pic_entry* entry;
-				while(item){
-					entry = item->data;
-					if(entry->ori_id == id){
-						new_id = entry->new_id;
-						s_free(entry);
-						ac->rewrite_pic_list = g_list_remove_link(ac->rewrite_pic_list,item);
-						break;
-					}
-					item = item->next;
-				}
-				if(new_id == 0){
-					pic++;
-					continue;
-				}
-				beg = strchr(pic,'"')+1;
-				snprintf(buf,sizeof(buf),"%4d",new_id);
-				memcpy(beg,buf,4);
-				pic++;
-			}
-		}
 		newmsg->who = s_strdup(message->who);
 		newmsg->when = message->when;
-		//pic = newmsg->what;
 		newlist = g_list_prepend(newlist,newmsg);
 		list = list->next;
 	}
-	purple_conversation_clear_message_history(conv);
+	if(conv) purple_conversation_clear_message_history(conv);
 	list = newlist;
 	while(list){
 		message = list->data;
-		qq_cgroup_got_msg(group->data, message->who, PURPLE_MESSAGE_RECV, message->what, message->when);
+		//each message is matched alone, an entry which isn't in history
+		//doesn't hold back the ones after it
+		if((item = find_rewrite_entry(pending,message))){
+			entry = item->data;
+			pending = g_list_delete_link(pending,item);
+			//nothing it is rendered from has changed, no need to render again
+			qq_cgroup_got_msg(group->data, entry->who, PURPLE_MESSAGE_RECV, entry->what, message->when);
+			rewrite_msg_entry_free(entry);
+		}else
+			qq_cgroup_got_msg(group->data, message->who, PURPLE_MESSAGE_RECV, message->what, message->when);
 		s_free(message->what);
 		s_free(message->who);
+		s_free(message);
 		list = list->next;
 	}
 	g_list_free(newlist);
+	//ir releases images of the rest
+	for(item=pending;item;item=item->next)
+		rewrite_msg_entry_free(item->data);
+	g_list_free(pending);
 }
 
 
@@ -942,9 +1100,8 @@ static int group_message(LwqqClient* lc,LwqqMsgMessage* msg)
 {
 	qq_account* ac = lwqq_client_userdata(lc);
 	LwqqGroup* group;
-	char piece[8192];
-	struct ds buf = ds_initializer, body = ds_initializer;
-	ds_sure(buf, BUFLEN);
+	char piece[32];
+	char* prefix = NULL,* notice = NULL;
 	if(msg->super.super.type == LWQQ_MS_GROUP_WEB_MSG){
 		group = find_group_by_gid(lc, msg->group_web.send);
 		if(group == NULL) return LWQQ_EC_OK;
@@ -956,37 +1113,54 @@ static int group_message(LwqqClient* lc,LwqqMsgMessage* msg)
 		switch(lwqq_msg_check_lost(lc, (LwqqMsg**)&msg, group)){
 			case 1:
 				snprintf(lost_msg, sizeof(lost_msg), "lost message from #%d to #%d",seq+1,msg->group.seq-1);
-				qq_cgroup_got_msg(group->data, msg->group.send, PURPLE_MESSAGE_ERROR, lost_msg, time(0));
+				notice = s_strdup(lost_msg);
 				break;
 			case -1:
 				snprintf(piece, sizeof(piece), "(#%d)", msg->group.seq);
-				ds_cat(buf, piece);
+				prefix = s_strdup(piece);
 				break;
 		}
 		lwqq_msg_check_member_chg(lc, (LwqqMsg**)&msg, group);
 	}
 
-
-	body = translate_struct_to_message(ac,msg,PURPLE_MESSAGE_RECV);
-	ds_cat(buf, ds_c_str(body));
-
-	if(LIST_EMPTY(&group->members)) {
-		const char* pic = ds_c_str(buf);
-		while((pic = strstr(pic,"<IMG"))!=NULL){
-			int id;
-			sscanf(pic, "<IMG ID=\"%d\">",&id);
-			PurpleStoredImage* img = purple_imgstore_find_by_id(id);
-			size_t len = purple_imgstore_get_size(img);
-			void * img_data = s_malloc(len);
-			memcpy(img_data,purple_imgstore_get_data(img),len);
-			int new_id = purple_imgstore_add_with_id(img_data, len, NULL);
-			struct rewrite_pic_entry* entry = s_malloc0(sizeof(*entry));
-			entry->ori_id = id;
-			entry->new_id = new_id;
-			entry->owner = group;
-			ac->rewrite_pic_list = g_list_append(ac->rewrite_pic_list,entry);
-			pic++;
-		}
+	struct recv_job local;
+	struct recv_job* job = recv_job_new(ac,msg,&local);
+	job->gid = s_strdup(group->gid);
+	job->who = s_strdup(msg->group.send);
+	job->prefix = prefix;
+	job->notice = notice;
+	recv_job_submit(ac,job);
+	return LWQQ_EC_OK;
+}
+static void group_message_show(qq_account* ac,struct recv_job* job)
+{
+	LwqqClient* lc = ac->qq;
+	//group could be deleted while job was waiting
+	LwqqGroup* group = find_group_by_gid(lc,job->gid);
+	struct ds buf = ds_initializer;
+	if(group == NULL || group->data == NULL) return;
+
+	if(job->notice)
+		qq_cgroup_got_msg(group->data, job->who, PURPLE_MESSAGE_ERROR, job->notice, time(0));
+	//render directly after seq prefix, no intermediate copy
+	size_t prefix_len = job->prefix?strlen(job->prefix):0;
+	if(prefix_len) ds_pokes_n(buf, job->prefix, prefix_len);
+	translate_ir_append(ac,job->ir,&buf);
+
+	//the rendered buffer is shown once, then handed to rewrite entry
+	int rewrite = LIST_EMPTY(&group->members);//else set user list in cgroup_got_msg
+	qq_cgroup_got_msg(group->data, job->who, PURPLE_MESSAGE_RECV, ds_c_str(buf), job->when);
+	if(rewrite) {
+		//keep ir, it holds images until shown again
+		struct rewrite_msg_entry* entry = s_malloc0(sizeof(*entry));
+		entry->owner = group;
+		entry->who = s_strdup(job->who);
+		entry->when = job->when;
+		entry->what = ds_c_str(buf);
+		buf.d = NULL;
+		entry->ir = job->ir;
+		job->ir = NULL;
+		ac->rewrite_msg_list = g_list_prepend(ac->rewrite_msg_list,entry);
 		//first check there is a event on queue.
 		//if it is. it would do anything.
 		//so we didn't do in this.
@@ -995,35 +1169,41 @@ static int group_message(LwqqClient* lc,LwqqMsgMessage* msg)
 			ev = lwqq_info_get_group_detail_info(lc,group,NULL);
 			lwqq_async_add_event_listener(ev,_C_(3p,rewrite_whole_message_list,ev,ac,group));
 		}
-	}//else set user list in cgroup_got_msg
-
-	qq_cgroup_got_msg(group->data, msg->group.send, PURPLE_MESSAGE_RECV, ds_c_str(buf), msg->time);
+	}
 	ds_free(buf);
-	ds_free(body);
-	return LWQQ_EC_OK;
 }
 static void whisper_message(LwqqClient* lc,LwqqMsgMessage* mmsg)
 {
 	qq_account* ac = lwqq_client_userdata(lc);
+	struct recv_job local;
+	struct recv_job* job = recv_job_new(ac,mmsg,&local);
+	job->who = s_strdup(mmsg->super.from);
+	job->gid = s_strdup(mmsg->sess.id);
+	recv_job_submit(ac,job);
+}
+static void whisper_message_show(qq_account* ac,struct recv_job* job)
+{
+	LwqqClient* lc = ac->qq;
 	PurpleConnection* pc = ac->gc;
-
-	const char* from = mmsg->super.from;
-	const char* gid = mmsg->sess.id;
+	const char* from = job->who;
+	const char* gid = job->gid;
 	char name[70]={0};
 	struct ds buf = ds_initializer;
 
-	buf = translate_struct_to_message(ac,mmsg,PURPLE_MESSAGE_RECV);
+	translate_ir_append(ac,job->ir,&buf);
 
 	LwqqGroup* group = find_group_by_gid(lc,gid);
 	if(group == NULL) {
 		snprintf(name,sizeof(name),"%s #(broken)# %s",from,gid);
-		serv_got_im(pc,name,ds_c_str(buf),PURPLE_MESSAGE_RECV,mmsg->time);
+		serv_got_im(pc,name,ds_c_str(buf),PURPLE_MESSAGE_RECV,job->when);
 		ds_free(buf);
 		return;
 	}
 
-	LwqqCommand cmd = _C_(4pl,whisper_message_delay_display,ac,group,s_strdup(from),s_strdup(ds_c_str(buf)),mmsg->time);
-	ds_free(buf);
+	//pass rendered buffer to delay display directly
+	char* body = ds_c_str(buf);
+	buf.d = NULL;
+	LwqqCommand cmd = _C_(4pl,whisper_message_delay_display,ac,group,s_strdup(from),body,job->when);
 	if(LIST_EMPTY(&group->members)) {
 		lwqq_async_add_event_listener(lwqq_info_get_group_detail_info(lc,group,NULL),cmd);
 	} else
@@ -1122,9 +1302,17 @@ static void blist_change(LwqqClient* lc,LwqqMsgBlistChange* blist)
 	LwqqBuddy* buddy;
 	LwqqAsyncEvent* ev;
 	LwqqAsyncEvset* set;
+	qq_account* ac = lc->data;
 	LIST_FOREACH(sb,&blist->added_friends,entries){
-		//in this. we didn't add it to fast cache.
-		buddy = lwqq_buddy_find_buddy_by_uin(lc, sb->uin);
+		buddy = find_buddy_by_uin(lc, sb->uin);
+		if(buddy == NULL){
+			//new friend is only in lc->friends yet, index it before anything
+			//else looks for it
+			qq_account_linear_lookup(ac, "added buddy uin", sb->uin);
+			buddy = lwqq_buddy_find_buddy_by_uin(lc, sb->uin);
+			if(buddy == NULL) continue;
+			qq_account_insert_index_node(ac, buddy, NULL);
+		}
 		if(!buddy->qqnumber){
 			set = lwqq_async_evset_new();
 			ev = lwqq_info_get_friend_qqnumber(lc,buddy);
@@ -1136,7 +1324,7 @@ static void blist_change(LwqqClient* lc,LwqqMsgBlistChange* blist)
 			friend_come(lc, &buddy);
 		}
 	}
-	PurpleAccount* account = ((qq_account*)lc->data)->account;
+	PurpleAccount* account = ac->account;
 	LIST_FOREACH(buddy,&blist->removed_friends,entries){
 		const char* key = try_get(buddy->qqnumber,buddy->uin);
 		//when one side delete, b doesn't remove from blist
@@ -1146,10 +1334,9 @@ static void blist_change(LwqqClient* lc,LwqqMsgBlistChange* blist)
 		PurpleConversation* conv = 
 			purple_find_conversation_with_account(PURPLE_CONV_TYPE_IM, key, account);
 		if(conv) purple_conversation_destroy(conv);
-		if(b){
-			qq_account_remove_index_node(lc->data, buddy, NULL);
-			purple_blist_remove_buddy(b);
-		}
+		//buddy is freed by lwqq after this, drop it in both cases
+		qq_account_remove_index_node(ac, buddy, NULL);
+		if(b) purple_blist_remove_buddy(b);
 	}
 }
 static void friend_avatar(qq_account* ac,LwqqBuddy* buddy)
@@ -1291,6 +1478,8 @@ static void login_stage_f(LwqqClient* lc)
 	LwqqBuddy* buddy;
 	LwqqGroup* group;
 	qq_account* ac = lc->data;
+	//qqnumbers are known now, index them too
+	qq_account_rebuild_index(ac);
 	LIST_FOREACH(buddy,&lc->friends,entries) {
 		if(buddy->last_modify == -1 || buddy->last_modify == 0){
 			friend_come(lc, &buddy);
@@ -1363,6 +1552,9 @@ static void login_stage_3(LwqqClient* lc)
 
 	LwqqAsyncEvent* ev = NULL;
 
+	//clean below looks up every blist node
+	qq_account_rebuild_index(ac);
+
 	//we must put buddy and group clean before any add operation.
 	GSList* ptr = purple_blist_get_buddies();
 	while(ptr){
@@ -1370,7 +1562,7 @@ static void login_stage_3(LwqqClient* lc)
 		if(buddy->account == ac->account){
 			const char* qqnum = purple_buddy_get_name(buddy);
 			//if it isn't a qqnumber,we should delete it whatever.
-			if(lwqq_buddy_find_buddy_by_qqnumber(lc,qqnum)==NULL){
+			if(find_buddy_by_qqnumber(lc,qqnum)==NULL){
 				purple_blist_remove_buddy(buddy);
 			}
 		}
@@ -1580,12 +1772,13 @@ static void delete_group_local(LwqqClient* lc,const LwqqGroup** p_g)
 {
 	const LwqqGroup* g = *p_g;
 	qq_chat_group* cg = g->data;
-	if(!cg) return;
 	qq_account* ac = lc->data;
+	//group without chat node is indexed too
+	qq_account_remove_index_node(ac, NULL, g);
+	if(!cg) return;
 	const char* key = try_get(g->account,g->gid);
 	PurpleConversation* conv = purple_find_conversation_with_account(PURPLE_CONV_TYPE_CHAT, key, ac->account);
 	if(conv) purple_conversation_destroy(conv);
-	qq_account_remove_index_node(ac, NULL, g);
 	purple_blist_remove_chat(cg->chat);
 }
 static void flush_group_members(LwqqClient* lc,LwqqGroup** d)
@@ -1772,14 +1965,15 @@ static int qq_send_im(PurpleConnection *gc, const gchar *who, const gchar *what,
 	mmsg->f_style = ac->font.style;
 	strcpy(mmsg->f_color,"000000");
 
-	translate_message_to_struct(lc, who, what, msg, 1);
-
 	if(send_visual){
-		struct ds whatsnew = translate_struct_to_message(ac, mmsg, PURPLE_MESSAGE_SEND);
+		//echo is rendered while translating, no second pass over msg
+		struct ds whatsnew = ds_initializer;
+		translate_message_to_struct_echo(ac, who, what, msg, 1, &whatsnew);
 		PurpleConversation* conv = purple_find_conversation_with_account(PURPLE_CONV_TYPE_IM, who, ac->account);
 		purple_conversation_write(conv, NULL, ds_c_str(whatsnew), flags, time(NULL));
 		ds_free(whatsnew);
-	}
+	}else
+		translate_message_to_struct(ac->translator, who, what, msg, 1);
 
 	LwqqAsyncEvent* ev = lwqq_msg_send(lc,mmsg);
 	if(!ev) msg_unsend_print_reason(ac, msg, who);
@@ -1794,6 +1988,9 @@ static int qq_send_chat(PurpleConnection *gc, int id, const char *message, Purpl
 	PurpleConversation* conv = purple_find_chat(gc, id);
 	LwqqGroup* group = find_group_by_qqnumber(ac->qq,conv->name);
 	LwqqMsg* msg;
+#ifndef APPLE
+	struct ds echo = ds_initializer;
+#endif
 
 	msg = lwqq_msg_new(LWQQ_MS_GROUP_MSG);
 	LwqqMsgMessage *mmsg = (LwqqMsgMessage*)msg;
@@ -1810,14 +2007,20 @@ static int qq_send_chat(PurpleConnection *gc, int id, const char *message, Purpl
 	mmsg->f_style = ac->font.style;
 	strcpy(mmsg->f_color,"000000");
 
-	translate_message_to_struct(ac->qq, group->gid, message, msg, 1);
+#ifndef APPLE
+	//in adium it would automatic type send message
+	if(ac->flag & SEND_VISUALBILITY)
+		translate_message_to_struct_echo(ac, group->gid, message, msg, 1, &echo);
+	else
+#endif
+		translate_message_to_struct(ac->translator, group->gid, message, msg, 1);
 
 	LwqqAsyncEvent* ev = lwqq_msg_send(ac->qq,mmsg);
 	if(!ev) msg_unsend_print_reason(ac, msg, group->gid);
 	lwqq_async_add_event_listener(ev, _C_(4pl,send_receipt,ev,msg,s_strdup(group->gid),s_strdup(message),2L));
 #ifndef APPLE
-	//in adium it would automatic type send message
-	purple_conversation_write(conv,NULL,message,flags,time(NULL));
+	purple_conversation_write(conv,NULL,ds_c_str(echo)?ds_c_str(echo):message,flags,time(NULL));
+	ds_free(echo);
 #endif
 
 	return 1;
@@ -1904,8 +2107,8 @@ static void qq_group_add_or_join(PurpleConnection *gc, GHashTable *data)
 	if(key==NULL) return;
 	//if it is new add group so type is NULL
 	if(type == NULL){
-		//we may delete group .so we need query lc directly.
-		group = lwqq_group_find_group_by_qqnumber(lc, key);
+		//deleted group is dropped from fast index too, see delete_group_local
+		group = find_group_by_qqnumber(lc, key);
 		if(group==NULL){
 			//from now this is a add group query.
 			//we need send to server.
@@ -1919,7 +2122,7 @@ static void qq_group_add_or_join(PurpleConnection *gc, GHashTable *data)
 	//if above we found there is a group but type is NULL.
 	//so we open the group
 	if(group==NULL){
-		group = lwqq_group_find_group_by_account(lc,key);
+		group = find_group_by_chat_key(lc,key,type);
 		if(group == NULL) return;
 	}
 
@@ -1966,20 +2169,13 @@ char *qq_get_cb_real_name(PurpleConnection *gc, int id, const char *who)
 	return NULL;
 }
 
-#if 0
-static void on_create(void *data,PurpleConnection* gc)
-{
-	//on conversation create we add smileys to it.
-	PurpleConversation* conv = data;
-	translate_add_smiley_to_conversation(conv);
-}
-#endif
 static void qq_close(PurpleConnection *gc)
 {
 	qq_account* ac = purple_connection_get_protocol_data(gc);
 	if(!ac) return;
 
 	if(ac->relink_timer>0) purple_timeout_remove(ac->relink_timer);
+	recv_job_stop(ac);
 	if(lwqq_client_logined(ac->qq))
 		lwqq_logout(ac->qq, 3);// only wait 3 seconds to logout
 	lwqq_msglist_close(ac->qq->msg_list);
@@ -1990,7 +2186,6 @@ static void qq_close(PurpleConnection *gc)
 	purple_connection_set_protocol_data(gc,NULL);
 	lwdb_userdb_free(ac->db);
 	qq_account_free(ac);
-	translate_global_free();
 	g_ref_count -- ;
 	if(g_ref_count == 0){
 		lwqq_http_global_free(LWQQ_CLEANUP_IGNORE);
@@ -2729,20 +2924,12 @@ static GList* qq_blist_node_menu(PurpleBlistNode* node)
 	}
 	return act;
 }
-static void client_connect_signals(PurpleConnection* gc)
-{
-	static int handle;
-	void *h = &handle;
-
-	purple_signal_connect(purple_conversations_get_handle(),
-			"conversation-created", h,
-			PURPLE_CALLBACK(translate_add_smiley_to_conversation), NULL);
-}
 
 static void display_user_info(PurpleConnection* gc,LwqqBuddy* b,char *who)
 {
 	PurpleNotifyUserInfo* info = purple_notify_user_info_new();
 	qq_account* ac = gc->proto_data;
+	char level[128];
 #define ADD_INFO(k,v)   purple_notify_user_info_add_pair(info,k,v)
 #define ADD_HEADER(s)     purple_notify_user_info_add_section_break(info)
 	//#define ADD_HEADER(s)     purple_notify_user_info_add_section_header(info, s)
@@ -2751,7 +2938,7 @@ static void display_user_info(PurpleConnection* gc,LwqqBuddy* b,char *who)
 	ADD_INFO(_("Nick"),b->nick);
 	ADD_INFO(_("Mark"),b->markname);
 	ADD_INFO(_("Longnick"),b->long_nick);
-	ADD_INFO(_("Level"),qq_level_to_str(b->level));
+	ADD_INFO(_("Level"),qq_level_to_str(b->level,level,sizeof(level)));
 	ADD_HEADER(_("Self Information"));
 	ADD_INFO(_("Gender"), qq_gender_to_str(b->gender));
 	ADD_INFO(_("Shengxiao"),qq_shengxiao_to_str(b->shengxiao));
@@ -2822,8 +3009,8 @@ static void qq_add_buddies_to_discu(PurpleConnection* gc,int id,const char* mess
 	qq_account* ac = gc->proto_data;
 	LwqqClient* lc = ac->qq;
 	PurpleConversation* conv = purple_find_chat(gc, id);
-	LwqqGroup* discu = find_group_by_qqnumber(lc, conv->name)?:find_group_by_gid(lc,conv->name);
-	if(discu->type != LWQQ_GROUP_DISCU){
+	LwqqGroup* discu = find_group_by_gid(lc,conv->name);
+	if(discu == NULL || discu->type != LWQQ_GROUP_DISCU){
 		purple_notify_info(gc,_("Error"),_("Only Discussion Can Add new member"),NULL);
 		return;
 	}
@@ -2832,8 +3019,11 @@ static void qq_add_buddies_to_discu(PurpleConnection* gc,int id,const char* mess
 		b = find_buddy_by_qqnumber(lc, local_id);
 	else
 		b = find_buddy_by_uin(lc, local_id);
-	if(b == NULL)
+	if(b == NULL){
+		//names aren't indexed
+		qq_account_linear_lookup(ac, "buddy name", local_id);
 		b = lwqq_buddy_find_buddy_by_name(lc, local_id);
+	}
 	if(b == NULL){
 		purple_notify_warning(ac->account, _("Warning"), _("Coundn't find friend"), local_id);
 		return;
@@ -2953,6 +3143,8 @@ init_plugin(PurplePlugin *plugin)
 	options = g_list_append(options, option);
 	option = purple_account_option_int_new(_("Send Relink Time Interval(m)"), "relink_retry", 20);
 	options = g_list_append(options, option);
+	option = purple_account_option_int_new(_("Translate Threads(0 to disable)"), "translate_threads", 0);
+	options = g_list_append(options, option);
 
 #ifndef WITH_LIBEV
 	LWQQ_ASYNC_IMPLEMENT(impl_purple);
@@ -3086,6 +3278,8 @@ static void qq_login(PurpleAccount *account)
 	if((relink_retry = purple_account_get_int(account, "relink_retry", 0))>0)
 		ac->relink_timer = purple_timeout_add_seconds(relink_retry*60, relink_keepalive, ac);
 	lwqq_log_set_level(purple_account_get_int(account,"verbose",0));
+	int translate_threads = purple_account_get_int(account, "translate_threads", 0);
+	if(translate_threads>0) recv_job_start(ac,translate_threads);
 	ac->db = lwdb_userdb_new(username,NULL,0);
 	LwqqExtension* db_ext = lwdb_make_extension(ac->db);
 	db_ext->init(ac->qq, db_ext);
@@ -3109,7 +3303,6 @@ static void qq_login(PurpleAccount *account)
 		all_reset(ac,RESET_ALL);
 
 	purple_connection_set_protocol_data(pc,ac);
-	client_connect_signals(ac->gc);
 
 	PurpleProxyInfo* proxy = purple_proxy_get_setup(ac->account);
 	lwqq_http_proxy_set(lwqq_get_http_handle(ac->qq),proxy_map(proxy->type),proxy->host,proxy->port,proxy->username,proxy->password);